@@ -4,15 +4,20 @@
 namespace blackbox{
     extern "C" {
         #include "executor_private.h"
+        #include "log_ring.h"
+        #include "framebuffer.h"
     }
 }
 
 namespace user {
     extern "C" {
         #include "user.h"
-        #include USER_CODE_LIB
     }
 }
+// the user code is its own translation unit (as C, or C++ for programs that
+// use static_tasks.hpp), this only pulls in its library, so it goes outside
+// of the namespace and the extern "C"
+#include USER_CODE_LIB
 namespace hal {
     extern "C" {
         #include "hal.h"
@@ -22,11 +27,10 @@ namespace hal {
 bool ticking = true;
 
 /*
-events is an array of 32 counters. each counter counts how many times the corresponding event has occurred.
-right now, only the first 10 event counters are in use:
+button events are pushed straight into the executor's event ring, which is safe to do from an ISR.
+the events are:
 up_press, down_press, left_press, right_press, select_press, up_release, down_release, left_release, right_release, select_release
 */
-volatile uint8_t events[32];
 volatile uint32_t button_debounce_times[5] = {0, 0, 0, 0, 0};
 template <uint8_t ButtonIndex>
 void ISR_ButtonEvent() {
@@ -39,11 +43,11 @@ void ISR_ButtonEvent() {
     button_debounce_times[ButtonIndex] = now;
     // check if the button is pressed or released
     if (digitalRead(BUTTON_PIN(ButtonIndex)) == HIGH) {
-        events[ButtonIndex + 5]++;
-        debug_log("Button %u released, that event is now %u", ButtonIndex, events[ButtonIndex + 5]);
+        bool ok = blackbox::executor_push_event(ButtonIndex + 5);
+        debug_log_isr("Button %u released%s", ButtonIndex, ok ? "" : ", but the event ring is full");
     } else {
-        events[ButtonIndex]++;
-        debug_log("Button %u pressed, that event is now %u", ButtonIndex, events[ButtonIndex]);
+        bool ok = blackbox::executor_push_event(ButtonIndex);
+        debug_log_isr("Button %u pressed%s", ButtonIndex, ok ? "" : ", but the event ring is full");
     }
 
     // run the event loop again in case smth was waiting for a button
@@ -74,20 +78,20 @@ void setup(){
     blackbox::executor_init();
     debug_log("starting user code...");
     user::user_setup(); // call into user setup
+    // setup isn't a task, so nothing has shown what it drew yet
+    blackbox::framebuffer_present();
 }
 
-uint8_t events_copy[32];
-unsigned int plat_tick(unsigned int current_time) {
-    debug_log("plat_tick: %u", current_time);
+uint64_t plat_tick(uint64_t current_time) {
+    debug_log("plat_tick: %llu", (unsigned long long) current_time);
 
-    noInterrupts();
-    for (int i = 0; i < 32; i++) {
-        events_copy[i] = events[i];
-        events[i] = 0;
-    }
-    interrupts();
-    
-    uint32_t next_ts = blackbox::executor_tick_loop(current_time, events_copy);
+    // no need to touch interrupts here, the executor drains the event ring
+    // without locking
+    uint64_t next_ts = blackbox::executor_tick_until_us(
+        current_time,
+        EXECUTOR_BATCH_MAX_TASKS,
+        current_time + (uint64_t) EXECUTOR_BATCH_BUDGET_MS * 1000
+    );
   
     return next_ts;
 }  
@@ -96,24 +100,23 @@ void loop(){
   if (!ticking){
     return;
   }
-  uint32_t nextTimestamp = plat_tick(millis());
+  // the executor runs on 64-bit microseconds, so this never wraps around
+  uint64_t nextTimestamp = plat_tick(time_us_64());
+
+  // the batch is done, print what the ISRs and debug_print_deferred logged
+  blackbox::log_ring_flush();
   
-  debug_log("next timestamp is %x, in %u ms", nextTimestamp, nextTimestamp - millis());
+  debug_log("next timestamp is %llu, in %lld us", (unsigned long long) nextTimestamp, (long long) (nextTimestamp - time_us_64()));
 
   // no timers need the event loop to be reticked
 
-  if (nextTimestamp == 0xFFFFFFFFUL) {
+  if (nextTimestamp == EXECUTOR_WAKE_NEVER) {
     debug_log("no timers need the event loop to be reticked, waiting for interrupts...");
     ticking = false;
     return;
   }
 
-  uint32_t now = millis();
-  uint32_t delta = nextTimestamp - now;
-
-  if (nextTimestamp <= now) delta = 0;
-
-  while(millis()<now+delta){
+  while(time_us_64()<nextTimestamp){
   if(ticking){
     // there’s been an event that we need to handle
     break;
@@ -13,8 +13,12 @@
 #define DO_DEBUG_LOGGING 1
 #if(DO_DEBUG_LOGGING)
 #define debug_log(...) Serial.print("[DEBUG]: "); Serial.printf(__VA_ARGS__); Serial.println();
+// for ISRs, where printing takes far too long. the message goes into the log
+// ring (see log_ring.h), and is printed from loop()
+#define debug_log_isr(format, ...) blackbox::log_ring_write("[DEBUG]: " format, __VA_ARGS__)
 #else
 #define debug_log(...)
+#define debug_log_isr(...)
 #endif
 
 #endif
\ No newline at end of file
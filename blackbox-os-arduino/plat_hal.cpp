@@ -1,6 +1,7 @@
 // idk why this is the magic that makes the c/c++ interop work
 // but it is
 #include <Arduino.h>
+#include <hardware/sync.h>
 #include "hardware_defs.h"
 
 extern "C" {
@@ -14,6 +15,14 @@ uint32_t hal_millis(){
   return millis();
 }
 
+/*
+ * Get the number of microseconds since the application has started. This wraps
+ * around roughly every 71 minutes.
+ */
+uint32_t hal_micros(){
+  return micros();
+}
+
 /// LED Matrix
 uint8_t hal_matrix_state[8] = {0};
 
@@ -32,6 +41,20 @@ void hal_matrix_set_arr(uint8_t arr[8]){
     }
 }
 
+/*
+ * Set only the rows of the LED matrix whose bit is set in `rows`.
+ */
+void hal_matrix_set_rows(uint8_t arr[8], uint8_t rows){
+    for (int i = 0; i < 8; i++) {
+        if (!(rows & (1 << i))) continue;
+        hal_matrix_state[i] = arr[i];
+        // write to the LED matrix
+        rp2040.fifo.push(
+            (i << 8) | arr[i]
+        );
+    }
+}
+
 /*
  * Copy the current state of the LED matrix to an array.
  */
@@ -87,15 +110,22 @@ void hal_console_write(char* str){
  * Enter a critical section, disabling interrupts if they were already enabled.
  * This is a no-op if the platform does not support preemption.
  */
+// critical sections can nest (ex: a deferred log from an ISR, or from inside
+// another critical section), so only the outermost one restores the interrupt
+// state it found. both are only touched with interrupts off.
+static uint32_t critical_depth = 0;
+static uint32_t critical_saved_state = 0;
+
 void hal_critical_enter(){
-    noInterrupts();
+    uint32_t state = save_and_disable_interrupts();
+    if (critical_depth++ == 0) critical_saved_state = state;
 }
 
 /*
  * Leave a critical section, restoring the system to its previous state.
  */
 void hal_critical_exit(){
-    interrupts();
+    if (--critical_depth == 0) restore_interrupts(critical_saved_state);
 }
 
 /// Error handling
@@ -5,8 +5,14 @@
 #include "blackbox.h"
 #include "executor_private.h"
 #include "hal.h"
+#include "snapshot.h"
+#include "log_ring.h"
+#include "arena.h"
+#include "framebuffer.h"
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 /// Timing
 // this is aliased to millis by defines around the user code in server.js
@@ -15,12 +21,18 @@ time_stamp bb_millis() { // actually called as millis()!
   return hal_millis();
 }
 
+time_stamp_us bb_micros() {
+  return executor_micros();
+}
+
 /// Task management/event loop
 
+// the executor works in microseconds, the millisecond functions just scale up
+
 task_handle task_create_timeout(task_target target, time_duration duration) {
   return executor_api_task_create_timeout(
     target, 
-    hal_millis() + duration
+    executor_micros() + (uint64_t) duration * 1000
   );
 }
 
@@ -30,9 +42,31 @@ task_handle task_create_interval(task_target target, time_duration interval) {
     interval = 1;
   }
 
+  uint64_t interval_us = (uint64_t) interval * 1000;
+
+  return executor_api_task_create_interval(
+    target,
+    executor_micros() + interval_us,
+    interval_us
+  );
+}
+
+task_handle task_create_timeout_us(task_target target, time_duration_us duration) {
+  return executor_api_task_create_timeout(
+    target, 
+    executor_micros() + duration
+  );
+}
+
+task_handle task_create_interval_us(task_target target, time_duration_us interval) {
+  if (interval == 0) {
+    // bump to 1, a task interval of 0 isn't allowed
+    interval = 1;
+  }
+
   return executor_api_task_create_interval(
     target,
-    hal_millis() + interval,
+    executor_micros() + interval,
     interval
   );
 }
@@ -41,6 +75,54 @@ task_handle task_create_event(task_target target, event_mask events) {
   return executor_api_task_create_event(target, events);
 }
 
+task_handle task_create_coroutine(task_target target) {
+  return executor_api_task_create_coroutine(target);
+}
+
+uint32_t task_coroutine_resume_point(task_handle self) {
+  return executor_api_task_coroutine_resume_point(self);
+}
+
+void task_coroutine_yield(task_handle self, uint32_t resume_point) {
+  executor_api_task_coroutine_yield(self, resume_point);
+}
+
+void task_coroutine_sleep_us(
+  task_handle self,
+  uint32_t resume_point,
+  time_duration_us duration
+) {
+  executor_api_task_coroutine_sleep(
+    self,
+    resume_point,
+    executor_micros() + duration
+  );
+}
+
+void task_coroutine_wait_event(
+  task_handle self,
+  uint32_t resume_point,
+  event_mask events
+) {
+  executor_api_task_coroutine_wait_event(self, resume_point, events);
+}
+
+void task_emit_event(event_mask events) {
+  executor_api_emit_event(events);
+}
+
+void task_set_batched(task_handle handle, bool batched) {
+  executor_api_task_set_batched(handle, batched);
+}
+
+uint16_t task_activation_count() {
+  return executor_api_task_activation_count();
+}
+
+event_mask task_fired_events() {
+  return executor_api_task_fired_events();
+}
+
 void task_cancel(task_handle handle) {
   executor_api_task_cancel(handle);
 }
@@ -53,59 +135,233 @@ void task_unpause(task_handle handle) {
   executor_api_task_unpause(handle);
 }
 
+void task_set_group(task_handle handle, task_group group) {
+  executor_api_task_set_group(handle, group);
+}
+
+task_group task_set_default_group(task_group group) {
+  return executor_api_task_set_default_group(group);
+}
+
+void task_group_cancel(task_group_mask groups) {
+  executor_api_task_group_cancel(groups);
+}
+
+void task_group_pause(task_group_mask groups) {
+  executor_api_task_group_pause(groups);
+}
+
+void task_group_unpause(task_group_mask groups) {
+  executor_api_task_group_unpause(groups);
+}
+
+void task_set_priority(task_handle handle, task_priority priority) {
+  executor_api_task_set_priority(handle, priority);
+}
+
+void task_set_catch_up(task_handle handle, task_catch_up catch_up) {
+  executor_api_task_set_catch_up(handle, catch_up);
+}
+
+bool task_get_stats(task_handle handle, task_stats* out_stats) {
+  return executor_api_task_get_stats(handle, out_stats);
+}
+
+/// Channels
+
+// a ring buffer of fixed-size items, in memory owned by the user
+
+void bb_channel_init(
+  bb_channel* channel,
+  void* items,
+  uint16_t item_size,
+  uint16_t capacity
+) {
+  channel->items = (uint8_t*) items;
+  channel->item_size = item_size;
+  channel->capacity = capacity;
+  channel->head = 0;
+  channel->count = 0;
+  channel->consumer = 0;
+}
+
+void bb_channel_bind(bb_channel* channel, task_handle consumer) {
+  channel->consumer = consumer;
+}
+
+bool bb_channel_push(bb_channel* channel, const void* item) {
+  if (channel->count >= channel->capacity) return false;
+
+  // figure out where in the ring we should write the new item
+  uint16_t write_index = (channel->head + channel->count) % channel->capacity;
+
+  memcpy(
+    &channel->items[(uint32_t) write_index * channel->item_size],
+    item,
+    channel->item_size
+  );
+  channel->count++;
+
+  // a consumer that has since been cancelled is just ignored
+  if (channel->consumer != 0) {
+    executor_api_task_activate(channel->consumer);
+  }
+
+  return true;
+}
+
+bool bb_channel_pop(bb_channel* channel, void* out_item) {
+  if (channel->count == 0) return false;
+
+  memcpy(
+    out_item,
+    &channel->items[(uint32_t) channel->head * channel->item_size],
+    channel->item_size
+  );
+
+  // advance the head, wrapping around if needed
+  channel->head = (channel->head + 1) % channel->capacity;
+  channel->count--;
+
+  return true;
+}
+
+uint16_t bb_channel_count(bb_channel* channel) {
+  return channel->count;
+}
+
+/// Memory
+
+void* bb_arena_alloc(size_t size) {
+  return arena_alloc(size);
+}
+
+size_t bb_arena_mark() {
+  return arena_mark();
+}
+
+void bb_arena_reset(size_t mark) {
+  arena_reset(mark);
+}
+
+size_t bb_arena_used() {
+  return arena_used();
+}
+
+size_t bb_arena_high_water() {
+  return arena_high_water();
+}
+
+size_t bb_arena_size() {
+  return EXECUTOR_ARENA_SIZE;
+}
+
+// fixed-size objects carved out of the arena. freed objects are kept on a
+// list threaded through the objects themselves, and ones that have never been
+// handed out aren't on it at all, so init, alloc and free are all O(1).
+
+bool bb_pool_init(bb_pool* pool, uint16_t object_size, uint16_t capacity) {
+  // every object has to be able to hold the free list's pointer, and be
+  // aligned like anything else from the arena
+  uint32_t stride = object_size;
+  if (stride < sizeof(void*)) stride = sizeof(void*);
+  stride = (stride + (ARENA_ALIGN - 1)) & ~((uint32_t) ARENA_ALIGN - 1);
+
+  pool->objects = (uint8_t*) arena_alloc((size_t) stride * capacity);
+  pool->stride = stride;
+  pool->capacity = (pool->objects != NULL) ? capacity : 0;
+  bb_pool_reset(pool);
+
+  return (pool->objects != NULL);
+}
+
+void* bb_pool_alloc(bb_pool* pool) {
+  void* object;
+
+  if (pool->free_list != NULL) {
+    object = pool->free_list;
+    memcpy(&pool->free_list, object, sizeof(void*));
+  } else if (pool->untouched < pool->capacity) {
+    object = &pool->objects[(uint32_t) pool->untouched * pool->stride];
+    pool->untouched++;
+  } else {
+    return NULL;
+  }
+
+  pool->count++;
+
+  return object;
+}
+
+bool bb_pool_free(bb_pool* pool, void* object) {
+  // it has to be the start of an object that's been handed out
+  uint8_t* start = (uint8_t*) object;
+  if (start < pool->objects) return false;
+
+  size_t offset = (size_t) (start - pool->objects);
+  if (offset >= ((size_t) pool->untouched * pool->stride)) return false;
+  if ((offset % pool->stride) != 0) return false;
+
+  memcpy(object, &pool->free_list, sizeof(void*));
+  pool->free_list = object;
+  pool->count--;
+
+  return true;
+}
+
+void bb_pool_reset(bb_pool* pool) {
+  pool->count = 0;
+  pool->untouched = 0;
+  pool->free_list = NULL;
+}
+
+uint16_t bb_pool_count(bb_pool* pool) {
+  return pool->count;
+}
+
 /// LED Matrix
 
+// everything draws into the framebuffer, which only reaches the hal when it's
+// presented (see framebuffer.h)
+
 void bb_matrix_set_arr(uint8_t arr[8]) {
-  hal_matrix_set_arr(arr);
+  framebuffer_set(arr);
 }
 
 void bb_matrix_get_arr(uint8_t out_arr[8]) {
-  hal_matrix_get_arr(out_arr);
+  framebuffer_get(out_arr);
 }
 
-// TODO: reading and writing the entire matrix state to flip 1 pixel might be
-// inefficient if we're doing cross-language calls. do we store the full matrix
-// state somewhere? maybe here? maybe assumed as part of hal impl? idk
-
 void bb_matrix_set_pos(uint8_t x, uint8_t y, led_state state) {
   if (x >= 8 || y >= 8) return;
 
-  uint8_t matrix_state[8];
-  hal_matrix_get_arr(matrix_state);
+  uint8_t row = framebuffer_get_row(y);
 
   // x=0 is the leftmost led, but in the raw data, bit 0 is the rightmost led
   // do 7 - x to correct the ordering
   if (state == LED_ON) {
     // OR to flip led on
-    matrix_state[y] = (matrix_state[y] | 1 << (7 - x));
+    row = (row | 1 << (7 - x));
   } else {
     // AND with everything but our bit of interest to flip led off
-    matrix_state[y] = (matrix_state[y] & ~(1 << (7 - x)));
+    row = (row & ~(1 << (7 - x)));
   }
 
-  hal_matrix_set_arr(matrix_state);
+  framebuffer_set_row(y, row);
 }
 
 void bb_matrix_toggle_pos(uint8_t x, uint8_t y) {
   if (x >= 8 || y >= 8) return;
 
-  uint8_t matrix_state[8];
-  hal_matrix_get_arr(matrix_state);
-
   // XOR to toggle a bit
-  matrix_state[y] = (matrix_state[y] ^ 1 << (7 - x));
-
-  hal_matrix_set_arr(matrix_state);
+  framebuffer_set_row(y, framebuffer_get_row(y) ^ 1 << (7 - x));
 }
 
 led_state bb_matrix_get_pos(uint8_t x, uint8_t y) {
   // assume out-of-bounds LEDs are off
   if (x >= 8 || y >= 8) return LED_OFF;
 
-  uint8_t matrix_state[8];
-  hal_matrix_get_arr(matrix_state);
-
-  if (matrix_state[y] & (1 << (7 - x))) {
+  if (framebuffer_get_row(y) & (1 << (7 - x))) {
     return LED_ON;
   } else {
     return LED_OFF;
@@ -115,67 +371,406 @@ led_state bb_matrix_get_pos(uint8_t x, uint8_t y) {
 void bb_matrix_all_on() {
   uint8_t all_on[8] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
 
-  hal_matrix_set_arr(all_on);
+  framebuffer_set(all_on);
 }
 
 void bb_matrix_all_off() {
   uint8_t all_off[8] = {0};
 
-  hal_matrix_set_arr(all_off);
+  framebuffer_set(all_off);
 }
 
-/// Slices
+void bb_matrix_present() {
+  framebuffer_present();
+}
 
-void bb_slice_all_on(uint8_t start, uint8_t end) {
-  uint8_t matrix_state[8];
-  hal_matrix_get_arr(matrix_state);
+/// Bitboards
 
-  for (int i = start; i <= end; i++) {
-    int x = i % 8;
-    int y = (i - (i % 8)) / 8;
-    // OR to flip led on
-    matrix_state[y] = (matrix_state[y] | 1 << (7 - x));
+// every bit of a byte in every row, for building per-column and per-row masks
+#define BITBOARD_EACH_ROW 0x0101010101010101ull
+
+// pixels [start, start + length) of a row as a byte, cut off at the edges
+static uint8_t bitboard_span(int16_t start, int16_t length) {
+  int16_t lo = start < 0 ? 0 : start;
+  int16_t hi = start + length > 8 ? 8 : start + length;
+
+  if (hi <= lo) return 0;
+
+  return (0xFF >> lo) & (0xFF << (8 - hi));
+}
+
+// rows [start, start + length) as a bitboard, cut off at the edges
+static bb_bitboard bitboard_rows(int16_t start, int16_t length) {
+  int16_t lo = start < 0 ? 0 : start;
+  int16_t hi = start + length > 8 ? 8 : start + length;
+
+  if (hi <= lo) return 0;
+
+  // shifting a 64-bit number by 64 is undefined, so the full-height ends are
+  // special cased
+  bb_bitboard top = lo == 0 ? ~0ull : ~0ull >> (lo * 8);
+  bb_bitboard bottom = hi == 8 ? ~0ull : ~(~0ull >> (hi * 8));
+
+  return top & bottom;
+}
+
+// a filled rect, in int16_t so sizes computed from int8_t coordinates fit
+static bb_bitboard bitboard_rect(
+  int16_t x,
+  int16_t y,
+  int16_t width,
+  int16_t height
+) {
+  // the columns of the rect in every row, cut down to its rows
+  return bitboard_span(x, width) * BITBOARD_EACH_ROW & bitboard_rows(y, height);
+}
+
+// swap x and y, mirroring across the diagonal from the top left corner
+static bb_bitboard bitboard_transpose(bb_bitboard board) {
+  // swap 4x4 blocks, then 2x2 blocks, then single pixels
+  bb_bitboard t;
+  t = 0x0F0F0F0F00000000ull & (board ^ (board << 28));
+  board ^= t ^ (t >> 28);
+  t = 0x3333000033330000ull & (board ^ (board << 14));
+  board ^= t ^ (t >> 14);
+  t = 0x5500550055005500ull & (board ^ (board << 7));
+  board ^= t ^ (t >> 7);
+
+  return board;
+}
+
+bb_bitboard bb_bitboard_shift(
+  bb_bitboard board,
+  int8_t dx,
+  int8_t dy,
+  bb_shift_mode mode
+) {
+  bool wrap = mode == BB_SHIFT_WRAP;
+
+  if (wrap) {
+    dx = ((dx % 8) + 8) % 8;
+    dy = ((dy % 8) + 8) % 8;
+  } else if (dx <= -8 || dx >= 8 || dy <= -8 || dy >= 8) {
+    return 0;
+  }
+
+  // a row is a byte, so moving down is a shift by whole bytes
+  if (dy > 0) {
+    uint8_t n = dy * 8;
+    board = wrap ? (board >> n) | (board << (64 - n)) : board >> n;
+  } else if (dy < 0) {
+    uint8_t n = -dy * 8;
+    board = board << n;
   }
 
-  hal_matrix_set_arr(matrix_state);
+  // moving right shifts bits into the next row over, so mask off the columns
+  // they land in (or, when wrapping, move them back to the left edge)
+  if (dx > 0) {
+    bb_bitboard kept = (0xFF >> dx) * BITBOARD_EACH_ROW;
+    bb_bitboard moved = (board >> dx) & kept;
+    board = wrap ? moved | ((board << (8 - dx)) & ~kept) : moved;
+  } else if (dx < 0) {
+    bb_bitboard kept = (uint8_t) (0xFF << -dx) * BITBOARD_EACH_ROW;
+    board = (board << -dx) & kept;
+  }
+
+  return board;
 }
 
-void bb_slice_all_off(uint8_t start, uint8_t end) {
-  uint8_t matrix_state[8];
-  hal_matrix_get_arr(matrix_state);
+bb_bitboard bb_bitboard_flip_h(bb_bitboard board) {
+  // reverse the bits of every byte at once: swap nibbles, pairs, then bits
+  board = ((board >> 4) & 0x0F0F0F0F0F0F0F0Full)
+    | ((board & 0x0F0F0F0F0F0F0F0Full) << 4);
+  board = ((board >> 2) & 0x3333333333333333ull)
+    | ((board & 0x3333333333333333ull) << 2);
+  board = ((board >> 1) & 0x5555555555555555ull)
+    | ((board & 0x5555555555555555ull) << 1);
 
-  for (int i = start; i <= end; i++) {
-    int x = i % 8;
-    int y = (i - (i % 8)) / 8;
-    // AND with everything but our bit of interest to flip led off
-    matrix_state[y] = (matrix_state[y] & ~(1 << (7 - x)));
+  return board;
+}
+
+bb_bitboard bb_bitboard_flip_v(bb_bitboard board) {
+  return __builtin_bswap64(board);
+}
+
+bb_bitboard bb_bitboard_rotate(bb_bitboard board, uint8_t quarter_turns) {
+  switch (quarter_turns % 4) {
+    case 1:
+      return bb_bitboard_flip_h(bitboard_transpose(board));
+    case 2:
+      return bb_bitboard_flip_h(bb_bitboard_flip_v(board));
+    case 3:
+      return bb_bitboard_flip_v(bitboard_transpose(board));
+    default:
+      return board;
   }
+}
 
-  hal_matrix_set_arr(matrix_state);
+bb_bitboard bb_bitboard_rect(int8_t x, int8_t y, uint8_t width, uint8_t height) {
+  return bitboard_rect(x, y, width, height);
 }
 
-// FIXME: this is a naive implementation based on the old JavaScript
-void bb_slice_set_int(uint8_t start, uint8_t end, uint32_t x) {
-  uint8_t matrix_state[8];
-  hal_matrix_get_arr(matrix_state);
+bb_bitboard bb_bitboard_rect_outline(
+  int8_t x,
+  int8_t y,
+  uint8_t width,
+  uint8_t height
+) {
+  // the rect, minus the rect one pixel inside of it
+  return bitboard_rect(x, y, width, height)
+    & ~bitboard_rect(x + 1, y + 1, width - 2, height - 2);
+}
 
-  for (int i = 0; i < 32; i++) {
-    if (x >> i == 0) {
-      break;
+bb_bitboard bb_bitboard_line(int8_t x0, int8_t y0, int8_t x1, int8_t y1) {
+  // straight lines are just thin rects
+  if (y0 == y1) {
+    int8_t left = x0 < x1 ? x0 : x1;
+    return bitboard_rect(left, y0, abs(x1 - x0) + 1, 1);
+  }
+  if (x0 == x1) {
+    int8_t top = y0 < y1 ? y0 : y1;
+    return bitboard_rect(x0, top, 1, abs(y1 - y0) + 1);
+  }
+
+  // bresenham's, in int16_t so the steps can't overflow
+  bb_bitboard board = 0;
+  int16_t x = x0;
+  int16_t y = y0;
+  int16_t dx = abs(x1 - x0);
+  int16_t dy = -abs(y1 - y0);
+  int16_t step_x = x0 < x1 ? 1 : -1;
+  int16_t step_y = y0 < y1 ? 1 : -1;
+  int16_t error = dx + dy;
+
+  while (true) {
+    if (x >= 0 && x < 8 && y >= 0 && y < 8) {
+      board |= BB_BITBOARD_PIXEL(x, y);
     }
-    int index = end - i;
-    int index_x = index % 8;
-    int index_y = (index - (index % 8)) / 8;
-    if ((x >> i) & 1 == 1) {
-      // OR to flip led on
-      matrix_state[index_y] = (matrix_state[index_y] | 1 << (7 - index_x));
-    } else {
-      // AND with everything but our bit of interest to flip led off
-      matrix_state[index_y] = (matrix_state[index_y] & ~(1 << (7 - index_x)));
+
+    if (x == x1 && y == y1) break;
+
+    int16_t error2 = error * 2;
+    if (error2 >= dy) {
+      error += dy;
+      x += step_x;
     }
+    if (error2 <= dx) {
+      error += dx;
+      y += step_y;
+    }
+  }
+
+  return board;
+}
+
+bb_bitboard bb_matrix_get_bitboard() {
+  bb_bitboard board = 0;
+
+  for (uint8_t y=0; y<8; y++) {
+    board = (board << 8) | framebuffer_get_row(y);
   }
 
-  hal_matrix_set_arr(matrix_state);
+  return board;
+}
+
+void bb_matrix_set_bitboard(bb_bitboard board) {
+  for (uint8_t y=0; y<8; y++) {
+    framebuffer_set_row(y, board >> ((7 - y) * 8));
+  }
+}
+
+void bb_matrix_and(bb_bitboard board) {
+  bb_matrix_set_bitboard(bb_matrix_get_bitboard() & board);
+}
+
+void bb_matrix_or(bb_bitboard board) {
+  bb_matrix_set_bitboard(bb_matrix_get_bitboard() | board);
+}
+
+void bb_matrix_xor(bb_bitboard board) {
+  bb_matrix_set_bitboard(bb_matrix_get_bitboard() ^ board);
+}
+
+void bb_matrix_invert() {
+  bb_matrix_set_bitboard(~bb_matrix_get_bitboard());
+}
+
+void bb_matrix_scroll(int8_t dx, int8_t dy, bb_shift_mode mode) {
+  bb_matrix_set_bitboard(bb_bitboard_shift(bb_matrix_get_bitboard(), dx, dy, mode));
+}
+
+void bb_matrix_flip_h() {
+  bb_matrix_set_bitboard(bb_bitboard_flip_h(bb_matrix_get_bitboard()));
+}
+
+void bb_matrix_flip_v() {
+  bb_matrix_set_bitboard(bb_bitboard_flip_v(bb_matrix_get_bitboard()));
+}
+
+void bb_matrix_rotate(uint8_t quarter_turns) {
+  bb_matrix_set_bitboard(
+    bb_bitboard_rotate(bb_matrix_get_bitboard(), quarter_turns)
+  );
+}
+
+/// Sprites
+
+// get a sprite's mask, with the pixels past its width cut off
+static void sprite_mask_rows(const bb_sprite* sprite, uint8_t out_rows[8]) {
+  uint8_t width_mask = bitboard_span(0, sprite->width);
+  uint8_t mask_used = 0;
+
+  // an empty mask means "use the pixels that are on"
+  for (uint8_t i=0; i<8; i++) mask_used |= sprite->mask[i];
+  const uint8_t* rows = mask_used ? sprite->mask : sprite->rows;
+
+  for (uint8_t i=0; i<8; i++) out_rows[i] = rows[i] & width_mask;
+}
+
+// place sprite rows on a bitboard at (x, y), cutting off whatever's off the
+// matrix. every row is a single shift, and lands in its own byte.
+static bb_bitboard sprite_place(
+  const uint8_t rows[8],
+  uint8_t height,
+  int8_t x,
+  int8_t y
+) {
+  if (x <= -8 || x >= 8) return 0;
+  if (height > 8) height = 8;
+
+  bb_bitboard board = 0;
+
+  for (uint8_t i=0; i<height; i++) {
+    int16_t row_y = y + i;
+    if (row_y < 0 || row_y >= 8) continue;
+
+    uint8_t row = x >= 0 ? rows[i] >> x : (uint8_t) (rows[i] << -x);
+    board |= (bb_bitboard) row << ((7 - row_y) * 8);
+  }
+
+  return board;
+}
+
+bb_bitboard bb_sprite_bitboard(const bb_sprite* sprite, int8_t x, int8_t y) {
+  uint8_t width_mask = bitboard_span(0, sprite->width);
+  uint8_t rows[8];
+
+  for (uint8_t i=0; i<8; i++) rows[i] = sprite->rows[i] & width_mask;
+
+  return sprite_place(rows, sprite->height, x, y);
+}
+
+bb_bitboard bb_sprite_mask_bitboard(const bb_sprite* sprite, int8_t x, int8_t y) {
+  uint8_t rows[8];
+  sprite_mask_rows(sprite, rows);
+
+  return sprite_place(rows, sprite->height, x, y);
+}
+
+void bb_sprite_blit(
+  const bb_sprite* sprite,
+  int8_t x,
+  int8_t y,
+  bb_blit_mode mode
+) {
+  bb_bitboard pixels = bb_sprite_bitboard(sprite, x, y);
+
+  switch (mode) {
+    case BB_BLIT_OR:
+      bb_matrix_or(pixels);
+      break;
+    case BB_BLIT_XOR:
+      bb_matrix_xor(pixels);
+      break;
+    case BB_BLIT_MASK: {
+      bb_bitboard mask = bb_sprite_mask_bitboard(sprite, x, y);
+      bb_matrix_set_bitboard(
+        (bb_matrix_get_bitboard() & ~mask) | (pixels & mask)
+      );
+      break;
+    }
+  }
+}
+
+bool bb_sprite_collide(
+  const bb_sprite* a,
+  int8_t a_x,
+  int8_t a_y,
+  const bb_sprite* b,
+  int8_t b_x,
+  int8_t b_y
+) {
+  // line b up with a, and AND the rows where they overlap. this is done
+  // relative to a (not on a bitboard) so it works off the matrix too.
+  int16_t dx = b_x - a_x;
+  int16_t dy = b_y - a_y;
+  if (dx <= -8 || dx >= 8 || dy <= -8 || dy >= 8) return false;
+
+  uint8_t a_height = a->height > 8 ? 8 : a->height;
+  uint8_t b_height = b->height > 8 ? 8 : b->height;
+  uint8_t a_rows[8];
+  uint8_t b_rows[8];
+  sprite_mask_rows(a, a_rows);
+  sprite_mask_rows(b, b_rows);
+
+  for (uint8_t a_row=0; a_row<a_height; a_row++) {
+    int16_t b_row = a_row - dy;
+    if (b_row < 0 || b_row >= b_height) continue;
+
+    uint8_t b_bits = b_rows[b_row];
+    b_bits = dx >= 0 ? b_bits >> dx : (uint8_t) (b_bits << -dx);
+
+    if (a_rows[a_row] & b_bits) return true;
+  }
+
+  return false;
+}
+
+bool bb_sprite_collide_matrix(const bb_sprite* sprite, int8_t x, int8_t y) {
+  return (bb_matrix_get_bitboard() & bb_sprite_mask_bitboard(sprite, x, y)) != 0;
+}
+
+/// Slices
+
+// slice index i is bit 63 - i of a bitboard, so a slice is one run of bits
+
+// the bits of the slice from start to end (inclusive), cut off at the end of
+// the matrix
+static bb_bitboard slice_mask(uint8_t start, uint8_t end) {
+  if (start > end || start > 63) return 0;
+  if (end > 63) end = 63;
+
+  uint8_t length = end - start + 1;
+  bb_bitboard bits = length == 64 ? ~0ull : (1ull << length) - 1;
+
+  return bits << (63 - end);
+}
+
+void bb_slice_all_on(uint8_t start, uint8_t end) {
+  bb_matrix_or(slice_mask(start, end));
+}
+
+void bb_slice_all_off(uint8_t start, uint8_t end) {
+  bb_matrix_and(~slice_mask(start, end));
+}
+
+void bb_slice_set_int(uint8_t start, uint8_t end, uint32_t x) {
+  bb_bitboard mask = slice_mask(start, end);
+  if (mask == 0) return;
+
+  // the lowest bit of x goes on `end`. when end is past the matrix, the bits
+  // that would land past it are dropped (all of them, once it's 32 or more
+  // past, which also keeps the shift in range).
+  bb_bitboard bits;
+  if (end <= 63) {
+    bits = (bb_bitboard) x << (63 - end);
+  } else if (end - 63 < 32) {
+    bits = (bb_bitboard) x >> (end - 63);
+  } else {
+    bits = 0;
+  }
+
+  bb_matrix_set_bitboard((bb_matrix_get_bitboard() & ~mask) | (bits & mask));
 }
 
 /// Synchronous Input
@@ -191,10 +786,14 @@ bool bb_get_button(bb_button button) {
 
 void bb_tone(uint16_t frequency) {
   hal_tone(frequency);
+  snapshot_track_tone(frequency);
+  executor_api_trace(TRACE_HAL_TONE, frequency);
 }
 
 void bb_tone_off() {
   hal_tone_off();
+  snapshot_track_tone(0);
+  executor_api_trace(TRACE_HAL_TONE, 0);
 }
 
 /// Random
@@ -217,9 +816,18 @@ uint16_t bb_rand(uint16_t min, uint16_t max) {
   return min + scaled;
 }
 
+/// Snapshots
+
+bool bb_snapshot_region(void* start, size_t size) {
+  return snapshot_add_region(start, size);
+}
+
 /// Debug
 
 uint32_t debug_print(const char* str, ...) {
+  // anything deferred was logged first, so it should be printed first
+  log_ring_flush();
+
   va_list arg, arg2;
   va_start(arg, str);
   va_copy(arg2, arg);
@@ -238,3 +846,16 @@ uint32_t debug_print(const char* str, ...) {
 
   return string_size;
 }
+
+bool debug_print_deferred(const char* str, ...) {
+  va_list arg;
+  va_start(arg, str);
+  bool ok = log_ring_writev(str, arg);
+  va_end(arg);
+
+  return ok;
+}
+
+void debug_print_tasks() {
+  executor_api_debug_print_tasks();
+}
@@ -0,0 +1,92 @@
+/*
+ * arena.c: The memory that user programs allocate from
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "arena.h"
+
+/*
+ * =============
+ * === STATE ===
+ * =============
+ */
+
+static uint8_t arena_memory[EXECUTOR_ARENA_SIZE] __attribute__((aligned(ARENA_ALIGN)));
+
+// bytes in use, everything below this has been handed out
+static size_t arena_top = 0;
+
+// the highest arena_top has ever been
+static size_t arena_top_max = 0;
+
+/*
+ * ==================
+ * === ALLOCATION ===
+ * ==================
+ */
+
+void* arena_alloc(size_t size) {
+  if (size == 0) return NULL;
+
+  size_t start = (arena_top + (ARENA_ALIGN - 1)) & ~((size_t) ARENA_ALIGN - 1);
+
+  // careful not to overflow on huge sizes
+  if (start > EXECUTOR_ARENA_SIZE) return NULL;
+  if (size > (EXECUTOR_ARENA_SIZE - start)) return NULL;
+
+  arena_top = start + size;
+  if (arena_top > arena_top_max) arena_top_max = arena_top;
+
+  return &arena_memory[start];
+}
+
+size_t arena_mark() {
+  return arena_top;
+}
+
+void arena_reset(size_t mark) {
+  if (mark > arena_top) return;
+
+  arena_top = mark;
+}
+
+size_t arena_used() {
+  return arena_top;
+}
+
+size_t arena_high_water() {
+  return arena_top_max;
+}
+
+/*
+ * =================
+ * === SNAPSHOTS ===
+ * =================
+ */
+
+// the arena's part of a snapshot is the top (u32), then that many bytes
+
+void arena_snapshot(snapshot_writer* writer) {
+  uint32_t used = arena_top;
+  snapshot_write(writer, &used, sizeof(used));
+  snapshot_write(writer, arena_memory, arena_top);
+}
+
+const uint8_t* arena_restore_check(snapshot_reader* reader, size_t* out_used) {
+  uint32_t used;
+  snapshot_read(reader, &used, sizeof(used));
+  if (!reader->ok || (used > EXECUTOR_ARENA_SIZE)) return NULL;
+
+  *out_used = used;
+
+  return snapshot_skip(reader, used);
+}
+
+void arena_restore(const uint8_t* contents, size_t used) {
+  memcpy(arena_memory, contents, used);
+
+  arena_top = used;
+  if (arena_top > arena_top_max) arena_top_max = arena_top;
+}
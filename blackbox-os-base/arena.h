@@ -0,0 +1,69 @@
+/*
+ * arena.h: The memory that user programs allocate from
+ *
+ * The platform reserves EXECUTOR_ARENA_SIZE bytes up front, and hands them out
+ * from the bottom up, like a stack: allocating is just moving the top, and
+ * memory is given back by moving the top back down to an earlier mark (ex:
+ * when a game switches scenes). There's no per-allocation free, so there's
+ * nothing to fragment, however long a program runs.
+ *
+ * Programs use this through bb_arena_alloc and the pools in blackbox.h.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "executor_config.h"
+#include "snapshot.h"
+
+// everything the arena hands out is aligned to this, which is enough for any
+// type but long double
+#define ARENA_ALIGN 8
+
+/*
+ * Take `size` bytes off the top of the arena. Returns NULL if there isn't
+ * enough left, or `size` is 0.
+ */
+void* arena_alloc(size_t size);
+
+/*
+ * Get the current top of the arena, to pass to arena_reset.
+ */
+size_t arena_mark();
+
+/*
+ * Give back everything allocated since `mark` was taken. Does nothing if
+ * `mark` is above the current top.
+ */
+void arena_reset(size_t mark);
+
+/*
+ * Get the number of bytes in use.
+ */
+size_t arena_used();
+
+/*
+ * Get the most bytes that have ever been in use at once.
+ */
+size_t arena_high_water();
+
+/*
+ * Write the part of the arena that's in use to a snapshot.
+ */
+void arena_snapshot(snapshot_writer* writer);
+
+/*
+ * Check the arena's part of a snapshot, and skip over it. Returns NULL if it's
+ * invalid, otherwise a pointer to pass to arena_restore.
+ */
+const uint8_t* arena_restore_check(snapshot_reader* reader, size_t* out_used);
+
+/*
+ * Put the arena back the way it was in a snapshot, with what
+ * arena_restore_check returned.
+ */
+void arena_restore(const uint8_t* contents, size_t used);
+
+#endif
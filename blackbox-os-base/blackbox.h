@@ -8,6 +8,13 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include <stddef.h>
+
+// so C++ programs can use it too (see static_tasks.hpp)
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #include "executor.h"
 #include "events.h"
 
@@ -18,6 +25,11 @@
  */
 time_stamp bb_millis();
 
+/*
+ * Get the number of microseconds since the application has started.
+ */
+time_stamp_us bb_micros();
+
 /// Task management/event loop
 
 /*
@@ -34,6 +46,20 @@ task_handle task_create_timeout(task_target target, time_duration duration);
  */
 task_handle task_create_interval(task_target target, time_duration interval);
 
+/*
+ * Schedule the given function to run after `duration` microseconds.
+ * Returns a task handle that can be used to manipulate the task, or 0 if the
+ * task failed to create.
+ */
+task_handle task_create_timeout_us(task_target target, time_duration_us duration);
+
+/*
+ * Schedule the given function to run every `interval` microseconds.
+ * Returns a task handle that can be used to manipulate the task, or 0 if the
+ * task failed to create.
+ */
+task_handle task_create_interval_us(task_target target, time_duration_us interval);
+
 /*
  * Register the given function as an event handler, to be run whenever the
  * specified event(s) occur.
@@ -42,6 +68,94 @@ task_handle task_create_interval(task_target target, time_duration interval);
  */
 task_handle task_create_event(task_target target, event_mask events);
 
+/*
+ * Create a coroutine task, which starts running `target` on the next tick.
+ * Inside the target, wrap the body in TASK_BEGIN(self) and TASK_END(), and use
+ * TASK_YIELD(), TASK_SLEEP_MS(ms) and TASK_WAIT_EVENT(events) to give control
+ * back to the executor. The coroutine picks up where it left off once it's
+ * resumed, and is cancelled once it reaches TASK_END() or returns.
+ *
+ * Coroutines don't have a stack: local variables are lost whenever the
+ * coroutine suspends, so keep anything that has to survive in static or
+ * global variables. Only one of the macros can be used per line, and they
+ * can't be used inside a switch statement.
+ * Returns a task handle that can be used to manipulate the task, or 0 if the
+ * task failed to create.
+ */
+task_handle task_create_coroutine(task_target target);
+
+// used by the coroutine macros, don't call these directly
+uint32_t task_coroutine_resume_point(task_handle self);
+void task_coroutine_yield(task_handle self, uint32_t resume_point);
+void task_coroutine_sleep_us(
+  task_handle self,
+  uint32_t resume_point,
+  time_duration_us duration
+);
+void task_coroutine_wait_event(
+  task_handle self,
+  uint32_t resume_point,
+  event_mask events
+);
+
+/*
+ * Start the body of a coroutine. `self` is the handle passed to the target.
+ */
+#define TASK_BEGIN(self) \
+  task_handle task_coroutine_self_ = (self); \
+  switch (task_coroutine_resume_point(task_coroutine_self_)) { \
+    case 0:
+
+/*
+ * End the body of a coroutine. Reaching this finishes the coroutine.
+ */
+#define TASK_END() \
+  } \
+  return
+
+/*
+ * Let everything else that's waiting to run go first, then resume.
+ */
+#define TASK_YIELD() \
+  do { \
+    task_coroutine_yield(task_coroutine_self_, __LINE__); \
+    return; \
+    case __LINE__:; \
+  } while (0)
+
+/*
+ * Suspend the coroutine for `duration` microseconds.
+ */
+#define TASK_SLEEP_US(duration) \
+  do { \
+    task_coroutine_sleep_us(task_coroutine_self_, __LINE__, (duration)); \
+    return; \
+    case __LINE__:; \
+  } while (0)
+
+/*
+ * Suspend the coroutine for `duration` milliseconds.
+ */
+#define TASK_SLEEP_MS(duration) \
+  TASK_SLEEP_US((time_duration_us) (duration) * 1000)
+
+/*
+ * Suspend the coroutine until any of the specified event(s) occur.
+ */
+#define TASK_WAIT_EVENT(events) \
+  do { \
+    task_coroutine_wait_event(task_coroutine_self_, __LINE__, (events)); \
+    return; \
+    case __LINE__:; \
+  } while (0)
+
+/*
+ * Fire the specified event(s) once, activating every task that's waiting for
+ * them. The subscribers are activated as soon as the current task returns.
+ * Use the EVENT_USER(n) events for your own events.
+ */
+void task_emit_event(event_mask events);
+
 /*
  * Cancel a task. This permanently prevents it from executing.
  */
@@ -58,6 +172,228 @@ void task_pause(task_handle handle);
  */
 void task_unpause(task_handle handle);
 
+/*
+ * Move a task into a group, so it can be cancelled, paused or unpaused along
+ * with the rest of the group. Use TASK_GROUP_NONE to take it out of its group.
+ */
+void task_set_group(task_handle handle, task_group group);
+
+/*
+ * Put every task created from now on in `group`, and return the group that was
+ * used before. Ex: set it before creating a scene's tasks, and put the old one
+ * back afterwards.
+ */
+task_group task_set_default_group(task_group group);
+
+/*
+ * Cancel every task in the group(s) in `groups`, built with TASK_GROUP_MASK.
+ */
+void task_group_cancel(task_group_mask groups);
+
+/*
+ * Pause every task in the group(s) in `groups`.
+ */
+void task_group_pause(task_group_mask groups);
+
+/*
+ * Unpause every task in the group(s) in `groups`.
+ */
+void task_group_unpause(task_group_mask groups);
+
+/*
+ * Change the priority of a task. Event tasks start out as TASK_PRIORITY_HIGH,
+ * and timeout/interval tasks as TASK_PRIORITY_NORMAL. If the task is already
+ * waiting to run, the new priority applies from its next activation.
+ */
+void task_set_priority(task_handle handle, task_priority priority);
+
+/*
+ * Change what an interval task does when it falls behind schedule. Interval
+ * tasks start out as TASK_CATCH_UP_ALL.
+ */
+void task_set_catch_up(task_handle handle, task_catch_up catch_up);
+
+/*
+ * Make a task take all of its pending activations in a single run, instead of
+ * running once for every activation. Ex: an event task for a button that was
+ * pressed 20 times since the last tick runs once, and task_activation_count()
+ * returns 20. Coroutines always run once per activation.
+ */
+void task_set_batched(task_handle handle, bool batched);
+
+/*
+ * Get how many activations the running task is handling in this run. This is
+ * always 1, unless the task is batched. Returns 0 if no task is running.
+ */
+uint16_t task_activation_count();
+
+/*
+ * Get which of its events fired since the running event task last ran.
+ * Returns 0 if the running task isn't an event task.
+ */
+event_mask task_fired_events();
+
+/*
+ * Copy the runtime statistics of a task into `out_stats`. Returns false if the
+ * task doesn't exist, or if the executor wasn't built with stats enabled.
+ */
+bool task_get_stats(task_handle handle, task_stats* out_stats);
+
+/// Channels
+
+/*
+ * A fixed-capacity queue of items, for passing data from one task to another.
+ * Pushing an item activates the channel's consumer task, so the consumer only
+ * runs when there's something for it to do. Use BB_CHANNEL_DEFINE to make one.
+ */
+typedef struct {
+  // storage for `capacity` items of `item_size` bytes each
+  uint8_t* items;
+  uint16_t item_size;
+  uint16_t capacity;
+  // index of the oldest item in the channel
+  uint16_t head;
+  // number of items currently in the channel
+  uint16_t count;
+  // the task to activate when an item is pushed (0 = none)
+  task_handle consumer;
+} bb_channel;
+
+/*
+ * Define a channel called `name`, which holds up to `capacity` items of
+ * `type`. Use this at the top level of your code, not inside a function.
+ */
+#define BB_CHANNEL_DEFINE(name, type, capacity) \
+  type name##_items[(capacity)]; \
+  bb_channel name = { \
+    (uint8_t*) name##_items, sizeof(type), (capacity), 0, 0, 0 \
+  }
+
+/*
+ * Set up a channel that holds up to `capacity` items of `item_size` bytes, in
+ * the memory pointed to by `items`. Any items already in it are dropped.
+ */
+void bb_channel_init(
+  bb_channel* channel,
+  void* items,
+  uint16_t item_size,
+  uint16_t capacity
+);
+
+/*
+ * Make `consumer` the task that's activated whenever an item is pushed into
+ * the channel. A consumer can be any task: an event task created with no
+ * events, or a coroutine waiting with TASK_WAIT_EVENT(0), only run when
+ * activated by a channel. Pass 0 to unbind the consumer.
+ */
+void bb_channel_bind(bb_channel* channel, task_handle consumer);
+
+/*
+ * Copy an item into the channel, and activate the consumer. Returns false (and
+ * does nothing) if the channel is full.
+ */
+bool bb_channel_push(bb_channel* channel, const void* item);
+
+/*
+ * Copy the oldest item in the channel to `out_item` and remove it. Returns
+ * false if the channel is empty.
+ */
+bool bb_channel_pop(bb_channel* channel, void* out_item);
+
+/*
+ * Get the number of items currently in the channel.
+ */
+uint16_t bb_channel_count(bb_channel* channel);
+
+/// Memory
+
+// the black box sets aside a fixed amount of memory (the arena) for programs
+// to allocate from. it's handed out from the bottom up, and given back all at
+// once by going back to an earlier mark, so it never fragments.
+
+/*
+ * Allocate `size` bytes from the arena, aligned for any type. The memory isn't
+ * cleared. Returns NULL if the arena doesn't have that much left.
+ */
+void* bb_arena_alloc(size_t size);
+
+/*
+ * Allocate an array of `count` items of `type` from the arena.
+ */
+#define BB_ARENA_NEW(type, count) ((type*) bb_arena_alloc(sizeof(type) * (count)))
+
+/*
+ * Get a mark for everything allocated so far, to go back to with
+ * bb_arena_reset.
+ */
+size_t bb_arena_mark();
+
+/*
+ * Free everything allocated since `mark` was taken (ex: everything a scene of
+ * a game allocated), including any pools it made.
+ */
+void bb_arena_reset(size_t mark);
+
+/*
+ * Get the number of bytes of the arena in use.
+ */
+size_t bb_arena_used();
+
+/*
+ * Get the most bytes of the arena that have ever been in use at once.
+ */
+size_t bb_arena_high_water();
+
+/*
+ * Get the total size of the arena, in bytes.
+ */
+size_t bb_arena_size();
+
+/*
+ * A fixed number of same-sized objects, that can be allocated and freed in any
+ * order. Use bb_pool_init to set one up.
+ */
+typedef struct {
+  // storage for `capacity` objects, `stride` bytes apart
+  uint8_t* objects;
+  uint32_t stride;
+  uint16_t capacity;
+  // number of objects allocated
+  uint16_t count;
+  // objects from here on have never been allocated
+  uint16_t untouched;
+  // freed objects, each holding a pointer to the next
+  void* free_list;
+} bb_pool;
+
+/*
+ * Set up a pool of `capacity` objects of `object_size` bytes, taking its
+ * storage from the arena. Returns false if the arena doesn't have room.
+ */
+bool bb_pool_init(bb_pool* pool, uint16_t object_size, uint16_t capacity);
+
+/*
+ * Allocate an object from the pool, aligned for any type. The memory isn't
+ * cleared. Returns NULL if every object is in use.
+ */
+void* bb_pool_alloc(bb_pool* pool);
+
+/*
+ * Give an object back to the pool. Returns false (and does nothing) if it
+ * isn't one of the pool's objects. Don't free an object twice!
+ */
+bool bb_pool_free(bb_pool* pool, void* object);
+
+/*
+ * Free every object in the pool at once.
+ */
+void bb_pool_reset(bb_pool* pool);
+
+/*
+ * Get the number of objects allocated from the pool.
+ */
+uint16_t bb_pool_count(bb_pool* pool);
+
 /// LED Matrix
 
 typedef enum {
@@ -102,6 +438,13 @@ void bb_matrix_all_on();
  */
 void bb_matrix_all_off();
 
+/*
+ * Show everything drawn so far on the matrix. Drawing only changes the
+ * black box's copy of the matrix, which is shown after every task runs, so
+ * this is only needed to show something in the middle of a task.
+ */
+void bb_matrix_present();
+
 /// Slices
 
 void bb_slice_all_on(uint8_t start, uint8_t end);
@@ -110,6 +453,205 @@ void bb_slice_all_off(uint8_t start, uint8_t end);
 
 void bb_slice_set_int(uint8_t start, uint8_t end, uint32_t x);
 
+/// Bitboards
+
+/*
+ * The whole matrix as a single 64-bit number, one bit per pixel. The top row
+ * is the most significant byte, and the most significant bit of each byte is
+ * on the left, so the bit for (x, y) is bit 63 - (y * 8 + x), and the bit for
+ * a slice index i is bit 63 - i. Combine bitboards with &, | and ^, and invert
+ * them with ~.
+ */
+typedef uint64_t bb_bitboard;
+
+// the bitboard with only the pixel at (x, y) turned on
+#define BB_BITBOARD_PIXEL(x, y) ((bb_bitboard) 1 << (63 - ((y) * 8 + (x))))
+
+/*
+ * What happens to pixels that get shifted off the edge of a bitboard.
+ */
+typedef enum {
+  // they're gone, and the pixels shifted in from the other edge are off
+  BB_SHIFT_CLEAR = 0,
+  // they come back in from the other edge
+  BB_SHIFT_WRAP = 1,
+} bb_shift_mode;
+
+/*
+ * Move every pixel `dx` to the right and `dy` down (negative to go left or
+ * up).
+ */
+bb_bitboard bb_bitboard_shift(
+  bb_bitboard board,
+  int8_t dx,
+  int8_t dy,
+  bb_shift_mode mode
+);
+
+/*
+ * Mirror left-to-right.
+ */
+bb_bitboard bb_bitboard_flip_h(bb_bitboard board);
+
+/*
+ * Mirror top-to-bottom.
+ */
+bb_bitboard bb_bitboard_flip_v(bb_bitboard board);
+
+/*
+ * Rotate clockwise by `quarter_turns` quarter turns (ex: 1 for 90 degrees, 3
+ * for 90 degrees counterclockwise).
+ */
+bb_bitboard bb_bitboard_rotate(bb_bitboard board, uint8_t quarter_turns);
+
+/*
+ * A filled `width` by `height` rectangle with its top left corner at (x, y).
+ * The parts of it that are off the matrix are cut off.
+ */
+bb_bitboard bb_bitboard_rect(int8_t x, int8_t y, uint8_t width, uint8_t height);
+
+/*
+ * Same as bb_bitboard_rect, with only the outline.
+ */
+bb_bitboard bb_bitboard_rect_outline(
+  int8_t x,
+  int8_t y,
+  uint8_t width,
+  uint8_t height
+);
+
+/*
+ * A line from (x0, y0) to (x1, y1), both ends included. The parts of it that
+ * are off the matrix are cut off.
+ */
+bb_bitboard bb_bitboard_line(int8_t x0, int8_t y0, int8_t x1, int8_t y1);
+
+/*
+ * Get the whole matrix as a bitboard.
+ */
+bb_bitboard bb_matrix_get_bitboard();
+
+/*
+ * Set the whole matrix from a bitboard.
+ */
+void bb_matrix_set_bitboard(bb_bitboard board);
+
+/*
+ * Turn off every pixel that's off in `board`.
+ */
+void bb_matrix_and(bb_bitboard board);
+
+/*
+ * Turn on every pixel that's on in `board`.
+ */
+void bb_matrix_or(bb_bitboard board);
+
+/*
+ * Toggle every pixel that's on in `board`.
+ */
+void bb_matrix_xor(bb_bitboard board);
+
+/*
+ * Toggle every pixel.
+ */
+void bb_matrix_invert();
+
+/*
+ * Scroll the matrix `dx` to the right and `dy` down (negative to go left or
+ * up). See bb_bitboard_shift.
+ */
+void bb_matrix_scroll(int8_t dx, int8_t dy, bb_shift_mode mode);
+
+/*
+ * Mirror the matrix left-to-right.
+ */
+void bb_matrix_flip_h();
+
+/*
+ * Mirror the matrix top-to-bottom.
+ */
+void bb_matrix_flip_v();
+
+/*
+ * Rotate the matrix clockwise by `quarter_turns` quarter turns.
+ */
+void bb_matrix_rotate(uint8_t quarter_turns);
+
+/// Sprites
+
+/*
+ * A picture of up to 8x8 pixels, meant to be defined once as a const, ex:
+ *   static const bb_sprite ship = {
+ *     .width = 3, .height = 2, .rows = { 0x40, 0xE0 }
+ *   };
+ */
+typedef struct {
+  // size in pixels, up to 8 each. anything past them is ignored.
+  uint8_t width;
+  uint8_t height;
+  // one byte per row, top to bottom, with the most significant bit on the
+  // left (the same as bb_matrix_set_arr)
+  uint8_t rows[8];
+  // the pixels the sprite covers, laid out the same as `rows`. covered pixels
+  // that are off in `rows` get drawn as off by BB_BLIT_MASK, and count for
+  // collisions. if it's all zeros, the pixels that are on in `rows` are used.
+  uint8_t mask[8];
+} bb_sprite;
+
+/*
+ * How a sprite is combined with what's already on the matrix.
+ */
+typedef enum {
+  // turn on the sprite's pixels that are on
+  BB_BLIT_OR = 0,
+  // toggle the sprite's pixels that are on
+  BB_BLIT_XOR = 1,
+  // replace everything the sprite's mask covers with the sprite
+  BB_BLIT_MASK = 2,
+} bb_blit_mode;
+
+/*
+ * The pixels of a sprite that are on, as a bitboard, with its top left corner
+ * at (x, y). The parts of it that are off the matrix are cut off.
+ */
+bb_bitboard bb_sprite_bitboard(const bb_sprite* sprite, int8_t x, int8_t y);
+
+/*
+ * Same as bb_sprite_bitboard, for the pixels the sprite's mask covers.
+ */
+bb_bitboard bb_sprite_mask_bitboard(const bb_sprite* sprite, int8_t x, int8_t y);
+
+/*
+ * Draw a sprite with its top left corner at (x, y). The parts of it that are
+ * off the matrix are cut off.
+ */
+void bb_sprite_blit(
+  const bb_sprite* sprite,
+  int8_t x,
+  int8_t y,
+  bb_blit_mode mode
+);
+
+/*
+ * Check if the masks of two sprites overlap, with their top left corners at
+ * (a_x, a_y) and (b_x, b_y). Works anywhere, even off the matrix.
+ */
+bool bb_sprite_collide(
+  const bb_sprite* a,
+  int8_t a_x,
+  int8_t a_y,
+  const bb_sprite* b,
+  int8_t b_x,
+  int8_t b_y
+);
+
+/*
+ * Check if the mask of a sprite with its top left corner at (x, y) covers any
+ * pixel that's on in the matrix (ex: before drawing it, to see if it hit a
+ * wall).
+ */
+bool bb_sprite_collide_matrix(const bb_sprite* sprite, int8_t x, int8_t y);
+
 /// Synchronous Input
 
 typedef enum {
@@ -145,6 +687,16 @@ void bb_tone_off();
  */
 uint16_t bb_rand(uint16_t min, uint16_t max);
 
+/// Snapshots
+
+/*
+ * Save `size` bytes at `start` (ex: a struct holding your game's state) in
+ * snapshots, so restoring a snapshot puts them back too. Call this from
+ * setup, in the same order every time. Returns false if too many regions
+ * have been registered.
+ */
+bool bb_snapshot_region(void* start, size_t size);
+
 /// Debug
 
 /*
@@ -153,4 +705,24 @@ uint16_t bb_rand(uint16_t min, uint16_t max);
  */
 uint32_t debug_print(const char* str, ...);
 
+/*
+ * Like debug_print, but only the format string and the arguments are saved,
+ * and the message is formatted and printed later, when the black box is idle.
+ * Much faster than debug_print, for logging from code that runs often.
+ * The format string and any strings passed for %s have to stay around until
+ * then (string literals are fine). Returns false if too many messages are
+ * waiting, and this one was dropped.
+ */
+bool debug_print_deferred(const char* str, ...);
+
+/*
+ * Print the state of every task (and its stats, if enabled) and the task queue
+ * to the debug console.
+ */
+void debug_print_tasks();
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
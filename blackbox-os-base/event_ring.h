@@ -0,0 +1,122 @@
+/*
+ * event_ring.h: Lock-free queue of timestamped events, from the platform's
+ * interrupt handlers to the executor
+ *
+ * This is a single-producer, single-consumer ring: exactly one context (ex: the
+ * button ISRs, which can't interrupt each other) may push, and exactly one
+ * (the executor's tick) may pop. Neither side ever blocks or disables
+ * interrupts. The producer only writes `tail` and `dropped`, and the consumer
+ * only writes `head`, so all they need to agree on is the order those writes
+ * become visible in.
+ */
+
+#ifndef EVENT_RING_H
+#define EVENT_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "executor_config.h"
+
+// EXECUTOR_EVENT_RING_SIZE is a power of 2, so this turns a free-running
+// position into an index
+#define EVENT_RING_MASK (EXECUTOR_EVENT_RING_SIZE - 1)
+
+/*
+ * One occurrence of an event.
+ */
+typedef struct {
+  // hal_micros() at the moment the event happened
+  uint32_t timestamp;
+  // which event happened (bit number in an event_mask)
+  uint8_t event_id;
+} event_record;
+
+typedef struct {
+  event_record records[EXECUTOR_EVENT_RING_SIZE];
+  // positions only ever count up (wrapping at 65536), and are masked to get
+  // an index. tail - head is the number of records in the ring.
+  // position of the next record to pop, only written by the consumer
+  uint16_t head;
+  // position of the next record to push, only written by the producer
+  uint16_t tail;
+  // number of events thrown away because the ring was full, only written by
+  // the producer
+  uint32_t dropped;
+} event_ring;
+
+/*
+ * Empty the ring. Neither side can be using it while this runs.
+ */
+static inline void event_ring_init(event_ring* ring) {
+  ring->head = 0;
+  ring->tail = 0;
+  ring->dropped = 0;
+}
+
+/*
+ * Producer: add an event to the ring. Returns false (and counts it as dropped)
+ * if the ring is full.
+ */
+static inline bool event_ring_push(
+  event_ring* ring,
+  uint8_t event_id,
+  uint32_t timestamp
+) {
+  uint16_t tail = ring->tail;
+  // acquire: don't overwrite a record before the consumer is done reading it
+  uint16_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+  if ((uint16_t) (tail - head) >= EXECUTOR_EVENT_RING_SIZE) {
+    __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+    return false;
+  }
+
+  event_record* record = &ring->records[tail & EVENT_RING_MASK];
+  record->timestamp = timestamp;
+  record->event_id = event_id;
+
+  // release: the record has to be written before the consumer can see it
+  __atomic_store_n(&ring->tail, (uint16_t) (tail + 1), __ATOMIC_RELEASE);
+
+  return true;
+}
+
+/*
+ * Consumer: get the number of events waiting in the ring. More can be pushed
+ * at any moment, but never fewer than this can be popped.
+ */
+static inline uint16_t event_ring_count(event_ring* ring) {
+  // acquire: pairs with the release in event_ring_push, so the records counted
+  // here have been fully written
+  uint16_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+  return (uint16_t) (tail - ring->head);
+}
+
+/*
+ * Consumer: remove the oldest event from the ring, copying it to `out_record`.
+ * Returns false if the ring is empty.
+ */
+static inline bool event_ring_pop(event_ring* ring, event_record* out_record) {
+  uint16_t head = ring->head;
+
+  if (event_ring_count(ring) == 0) return false;
+
+  *out_record = ring->records[head & EVENT_RING_MASK];
+
+  // release: we have to be done reading the record before the producer can
+  // reuse its slot
+  __atomic_store_n(&ring->head, (uint16_t) (head + 1), __ATOMIC_RELEASE);
+
+  return true;
+}
+
+/*
+ * Get the number of events that have been dropped since the ring was
+ * initialized. Safe to call from either side.
+ */
+static inline uint32_t event_ring_dropped(event_ring* ring) {
+  return __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+}
+
+#endif
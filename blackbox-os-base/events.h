@@ -9,7 +9,7 @@
 
 typedef uint32_t event_mask;
 
-// currently, this is just buttons
+// the first 10 events are fed from the buttons by the platform
 
 #define EVENT_PRESS_UP       0x1
 #define EVENT_PRESS_DOWN     0x2
@@ -22,4 +22,9 @@ typedef uint32_t event_mask;
 #define EVENT_RELEASE_RIGHT  0x100
 #define EVENT_RELEASE_SELECT 0x200
 
+// the rest are free for user code to fire with task_emit_event
+// n goes from 0 to EVENT_USER_COUNT - 1
+#define EVENT_USER(n)        (0x400UL << (n))
+#define EVENT_USER_COUNT     22
+
 #endif
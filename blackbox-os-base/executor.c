@@ -5,8 +5,11 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
-#include "executor.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include "executor_private.h"
 #include "hal.h"
+#include "framebuffer.h"
 
 /*
  * ===============
@@ -14,13 +17,19 @@
  * ===============
  */
 
+// sizing lives in executor_config.h, these are just shorter names for it
+
 // maximum number of tasks that can be executed
-// each task takes 24 bytes of global memory (24 byte struct + 4 byte queue)
-#define NUM_TASKS 16
+#define NUM_TASKS EXECUTOR_NUM_TASKS
+
+// number of slots in the task queue
+#define QUEUE_SIZE EXECUTOR_QUEUE_SIZE
 
 // number of distinct events the system can handle
-// this is limited to 32 as each one occupies a bit in a uint32
-#define NUM_EVENTS 32
+#define NUM_EVENTS EXECUTOR_NUM_EVENTS
+
+// number of task priority levels (see task_priority in executor.h)
+#define NUM_PRIORITIES EXECUTOR_NUM_PRIORITIES
 
 // maximum number of activations a task can have
 #define MAX_ACTIVATIONS 65535
@@ -38,11 +47,44 @@
 #define TASK_STATUS_PAUSED 0x08
 // if this task should be cancelled the next time it goes through the queue
 #define TASK_STATUS_CANCEL_DEFERRED 0x10
+// if this coroutine is sleeping until the timestamp in data_a
+#define TASK_STATUS_WAIT_TIMER 0x20
+// if this coroutine is waiting for any of the events in data_a
+#define TASK_STATUS_WAIT_EVENT 0x40
+// if this task takes all of its pending activations in one run, instead of
+// running once per activation
+#define TASK_STATUS_BATCHED 0x80
 
 // if you want a task in the queue to be deleted without running it, combine
 // TASK_STATUS_PAUSED and TASK_STATUS_CANCEL_DEFERRED
 
-#define TIMESTAMP_MAX 0xFFFFFFFFUL
+// all timestamps inside the executor are 64-bit microseconds, so they won't
+// overflow for a few hundred thousand years
+// TIMESTAMP_MAX is used to mean "never"
+#define TIMESTAMP_MAX 0xFFFFFFFFFFFFFFFFULL
+
+// the millisecond api uses 32-bit timestamps, where this means "never"
+#define TIMESTAMP_MAX_MS 0xFFFFFFFFUL
+
+// timer_index value for tasks that aren't in the timer heap
+#define TIMER_HEAP_NONE 0xFFFF
+
+// sanity checks, see EXECUTOR_CHECK_LEVEL in executor_config.h
+// wrap the failure condition of a check in one of these. below the check's
+// level they're constant false, so the compiler drops the whole branch.
+// cheap checks guard against memory corruption or a crash (ex: an index out of
+// bounds), and anything the platform can get wrong (ex: time going backwards)
+#define CHECK_CHEAP(failed) \
+  ((EXECUTOR_CHECK_LEVEL >= EXECUTOR_CHECKS_CHEAP) && (failed))
+// full checks catch bugs in the executor itself, and run all over the hot path
+#define CHECK_FULL(failed) \
+  ((EXECUTOR_CHECK_LEVEL >= EXECUTOR_CHECKS_FULL) && (failed))
+
+// task handle layout (see the TASK IDS section)
+#define TASK_INDEX_BITS EXECUTOR_TASK_INDEX_BITS
+#define TASK_INDEX_MASK ((1UL << TASK_INDEX_BITS) - 1)
+// get the slot index out of a task handle
+#define TASK_ID_SLOT(id) ((slot_index) ((id) & TASK_INDEX_MASK))
 
 /*
  * =============
@@ -50,39 +92,8 @@
  * =============
  */
 
-typedef enum {
-  // task is activated by an external event
-  // data_a = bitfield of events
-  TASK_TYPE_EVENT = 0,
-  // task is activated by a one-off timeout, and then cancelled after
-  // data_a = timestamp that the
-  TASK_TYPE_TIMEOUT = 1,
-  // task is activated by a repeating interval
-  // data_a = next time to check for activation
-  // data_b = interval for activation (ms)
-  TASK_TYPE_INTERVAL = 2,
-} task_type;
-
-// this should pack down to 20 bytes (tested on clang armv7-a)
-typedef struct {
-  // the function to call to execute this task
-  task_target target;
-  // the full id (24-bit nonce and 8-bit index)
-  uint32_t id;
-  // the number of pending activations this task has
-  uint16_t pending_activations;
-  // the status flags of this task, as a bitfield
-  // NOTE: uint8_t to save size on struct alignment
-  uint8_t status_flags;
-
-  // the type of this task
-  // NOTE: uint8_t to save size on struct alignment
-  uint8_t type;
-  // data for this task (type-dependent)
-  uint32_t data_a;
-  // data for this task (type-dependent)
-  uint32_t data_b;
-} executor_task;
+// the task and instance types live in executor_private.h, so that platforms
+// can allocate executor instances themselves
 
 /*
  * ==================
@@ -90,9 +101,7 @@ typedef struct {
  * ==================
  */
 
-
-// all the tasks
-executor_task tasks[NUM_TASKS];
+// all the tasks live in executor_instance.tasks
 
 /*
  * =======================
@@ -105,7 +114,7 @@ executor_task tasks[NUM_TASKS];
  */
 static bool task_is(executor_task* task, uint8_t flags) {
   // sanity check
-  if (task == NULL) {
+  if (CHECK_FULL(task == NULL)) {
     hal_panic("task_check: received NULL task pointer");
     return false;
   }
@@ -118,7 +127,7 @@ static bool task_is(executor_task* task, uint8_t flags) {
  */
 static void task_set(executor_task* task, uint8_t flags) {
   // sanity check
-  if (task == NULL) {
+  if (CHECK_FULL(task == NULL)) {
     hal_panic("task_set: received NULL task pointer");
     return;
   }
@@ -131,7 +140,7 @@ static void task_set(executor_task* task, uint8_t flags) {
  */
 static void task_unset(executor_task* task, uint8_t flags) {
   // sanity check
-  if (task == NULL) {
+  if (CHECK_FULL(task == NULL)) {
     hal_panic("task_unset: received NULL task pointer");
     return;
   }
@@ -140,80 +149,450 @@ static void task_unset(executor_task* task, uint8_t flags) {
   task->status_flags = cur_flags & ~flags;
 }
 
+/*
+ * ==================
+ * === TASK STATS ===
+ * ==================
+ */
+
+// per-slot runtime statistics, only collected if EXECUTOR_ENABLE_STATS is set
+// when it isn't, all of these helpers are empty and compile away to nothing
+
+// the stats live in executor_instance.slot_stats
+
+// clear the stats for a newly allocated task
+static void stats_reset(executor_instance* ex, slot_index task_slot) {
+#if EXECUTOR_ENABLE_STATS
+  memset(&ex->slot_stats[task_slot], 0, sizeof(ex->slot_stats[task_slot]));
+  ex->slot_queued_at[task_slot] = 0;
+#else
+  (void) ex;
+  (void) task_slot;
+#endif
+}
+
+// count activations thrown away by the MAX_ACTIVATIONS clamp
+static void stats_add_dropped(
+  executor_instance* ex,
+  executor_task* task,
+  uint32_t dropped
+) {
+#if EXECUTOR_ENABLE_STATS
+  ex->slot_stats[TASK_ID_SLOT(task->id)].dropped_activations += dropped;
+#else
+  (void) ex;
+  (void) task;
+  (void) dropped;
+#endif
+}
+
+// remember when a task went on the queue, to measure its latency later
+static void stats_mark_queued(executor_instance* ex, executor_task* task) {
+#if EXECUTOR_ENABLE_STATS
+  ex->slot_queued_at[TASK_ID_SLOT(task->id)] = hal_micros();
+#else
+  (void) ex;
+  (void) task;
+#endif
+}
+
+// count a newly queued task's latency from an earlier time instead (ex: when
+// the event that activated it actually happened)
+static void stats_backdate_queued(
+  executor_instance* ex,
+  executor_task* task,
+  uint32_t queued_at
+) {
+#if EXECUTOR_ENABLE_STATS
+  ex->slot_queued_at[TASK_ID_SLOT(task->id)] = queued_at;
+#else
+  (void) ex;
+  (void) task;
+  (void) queued_at;
+#endif
+}
+
+// get hal_micros(), but only if it's needed for the stats
+static uint32_t stats_now() {
+#if EXECUTOR_ENABLE_STATS
+  return hal_micros();
+#else
+  return 0;
+#endif
+}
+
+// record the queue latency of a task that's about to run
+// returns the start time, to be passed to stats_run_end
+static uint32_t stats_run_start(executor_instance* ex, executor_task* task) {
+#if EXECUTOR_ENABLE_STATS
+  slot_index task_slot = TASK_ID_SLOT(task->id);
+  task_stats* stats = &ex->slot_stats[task_slot];
+
+  uint32_t now = hal_micros();
+  uint32_t latency = now - ex->slot_queued_at[task_slot];
+
+  stats->total_latency += latency;
+  if (latency > stats->max_latency) stats->max_latency = latency;
+
+  return now;
+#else
+  (void) ex;
+  (void) task;
+
+  return 0;
+#endif
+}
+
+// record the run time of a task that just finished
+static void stats_run_end(
+  executor_instance* ex,
+  executor_task* task,
+  uint32_t start_time
+) {
+#if EXECUTOR_ENABLE_STATS
+  task_stats* stats = &ex->slot_stats[TASK_ID_SLOT(task->id)];
+
+  uint32_t run_time = hal_micros() - start_time;
+
+  stats->run_count++;
+  stats->total_run_time += run_time;
+  if (run_time > stats->max_run_time) stats->max_run_time = run_time;
+#else
+  (void) ex;
+  (void) task;
+  (void) start_time;
+#endif
+}
+
+/*
+ * ===============
+ * === TRACING ===
+ * ===============
+ */
+
+// a record of everything the executor does, only kept if EXECUTOR_ENABLE_TRACE
+// is set (see trace.h). like the stats, this compiles away to nothing when it
+// isn't.
+
+// the records live in executor_instance.trace, until the platform drains them
+
+// add a record to the trace
+static void trace_add(
+  executor_instance* ex,
+  trace_type type,
+  uint32_t task_id,
+  uint16_t value
+) {
+#if EXECUTOR_ENABLE_TRACE
+  trace_record record = {
+    .timestamp = hal_micros(),
+    .task_id = task_id,
+    .value = value,
+    .type = (uint8_t) type,
+  };
+
+  trace_ring_push(&ex->trace, &record);
+#else
+  (void) ex;
+  (void) type;
+  (void) task_id;
+  (void) value;
+#endif
+}
+
 /*
  * ==================
  * === TASK QUEUE ===
  * ==================
  */
 
-// ring buffer that represents the currently active task queue
-executor_task* task_queue[NUM_TASKS];
-// how many items are currently in the task queue
-uint8_t task_queue_size;
-// an index representing the head of the task queue
-uint8_t task_queue_head;
+// the task queue is split into one ring buffer per priority level
+// tasks are always taken from the highest priority (lowest numbered) level
+// that has anything in it, and in FIFO order within a level
+
+// the rings live in executor_instance.task_queue, with their bookkeeping
 
 // TODO: should task_queue_* modify the status bits of a task?
 // i'm wagering on no right now
 // though i will add sanity checks
 
 /*
- * Push an item to the task queue.
+ * Push an item to the task queue, at the back of its priority's ring.
  */
-static void task_queue_push(executor_task* task) {
-  if (task_queue_size >= NUM_TASKS) {
+static void task_queue_push(executor_instance* ex, executor_task* task) {
+  if (CHECK_FULL(task == NULL)) {
+    hal_panic("task_queue_push: task is null");
+    return;
+  }
+
+  uint8_t level = task->priority;
+
+  if (CHECK_CHEAP(level >= NUM_PRIORITIES)) {
+    hal_panic("task_queue_push: task has an invalid priority");
+    return;
+  }
+
+  if (CHECK_CHEAP(ex->task_queue_level_size[level] >= QUEUE_SIZE)) {
     // this should never happen, the rest of the code should make it impossible
     // but in case it does...
     hal_panic("task_queue_push: queue is full");
     return;
   }
 
-  if (task == NULL) {
-    hal_panic("task_queue_push: task is null");
+  if (CHECK_FULL(task_is(task, TASK_STATUS_ON_QUEUE))) {
+    hal_panic("task_queue_push: task was already queued");
     return;
   }
 
-  if (task_is(task, TASK_STATUS_ON_QUEUE)) {
-    hal_panic("task_queue_push: task was already queued");
+  // figure out where in the queue we should write the new task
+  uint16_t write_index = (
+    ex->task_queue_level_head[level] + ex->task_queue_level_size[level]
+  ) % QUEUE_SIZE;
+
+  ex->task_queue[level][write_index] = task;
+  ex->task_queue_level_size[level]++;
+  ex->task_queue_size++;
+
+  stats_mark_queued(ex, task);
+
+  ex->task_queue_levels |= (1 << level);
+}
+
+/*
+ * Pop the head of the highest priority non-empty ring. Returns NULL if the
+ * queue is empty.
+ */
+static executor_task* task_queue_pop(executor_instance* ex) {
+  if (ex->task_queue_size == 0) {
+    return NULL;
+  }
+
+  uint8_t level = __builtin_ctz(ex->task_queue_levels);
+
+  executor_task* item = ex->task_queue[level][ex->task_queue_level_head[level]];
+
+  // advance the head, wrapping around if needed
+  ex->task_queue_level_head[level] = (ex->task_queue_level_head[level] + 1) % QUEUE_SIZE;
+  ex->task_queue_level_size[level]--;
+  ex->task_queue_size--;
+
+  if (ex->task_queue_level_size[level] == 0) {
+    ex->task_queue_levels &= ~(1 << level);
+  }
+
+  return item;
+}
+
+/*
+ * ==================
+ * === TIMER HEAP ===
+ * ==================
+ */
+
+// binary min-heap of every timer (timeout/interval) task that can activate,
+// and every sleeping coroutine, ordered by data_a (the next activation
+// timestamp)
+// this lets the tick loop find due timers in O(due * log n) and the next
+// wakeup time in O(1), instead of scanning the whole task array twice
+// invariant: a task is in here iff it is alive, a timer type (or a coroutine
+// with TASK_STATUS_WAIT_TIMER), not paused and not pending cancellation.
+// task->timer_index always mirrors its position.
+// the heap lives in executor_instance.timer_heap
+
+// put a task at a position in the heap, keeping timer_index in sync
+static void timer_heap_place(
+  executor_instance* ex,
+  executor_task* task,
+  slot_index index
+) {
+  ex->timer_heap[index] = task;
+  task->timer_index = index;
+}
+
+// move the task at `index` towards the root until the heap property holds
+static void timer_heap_sift_up(executor_instance* ex, slot_index index) {
+  executor_task* task = ex->timer_heap[index];
+
+  while (index > 0) {
+    slot_index parent = (index - 1) / 2;
+    if (ex->timer_heap[parent]->data_a <= task->data_a) break;
+
+    timer_heap_place(ex, ex->timer_heap[parent], index);
+    index = parent;
+  }
+
+  timer_heap_place(ex, task, index);
+}
+
+// move the task at `index` towards the leaves until the heap property holds
+static void timer_heap_sift_down(executor_instance* ex, slot_index index) {
+  executor_task* task = ex->timer_heap[index];
+
+  while (true) {
+    uint32_t child = (uint32_t) index * 2 + 1;
+    if (child >= ex->timer_heap_size) break;
+
+    // pick the earlier of the two children
+    if (
+      (child + 1 < ex->timer_heap_size) &&
+      (ex->timer_heap[child + 1]->data_a < ex->timer_heap[child]->data_a)
+    ) {
+      child++;
+    }
+
+    if (task->data_a <= ex->timer_heap[child]->data_a) break;
+
+    timer_heap_place(ex, ex->timer_heap[child], index);
+    index = child;
+  }
+
+  timer_heap_place(ex, task, index);
+}
+
+/*
+ * Add a timer task to the heap. Does nothing if it's already in there.
+ */
+static void timer_heap_push(executor_instance* ex, executor_task* task) {
+  if (task->timer_index != TIMER_HEAP_NONE) return;
+
+  if (CHECK_CHEAP(ex->timer_heap_size >= NUM_TASKS)) {
+    hal_panic("timer_heap_push: heap is full");
     return;
   }
 
-  // figure out where in the queue we should write the new task
-  uint8_t write_index = (task_queue_head + task_queue_size) % NUM_TASKS;
+  timer_heap_place(ex, task, ex->timer_heap_size);
+  ex->timer_heap_size++;
+  timer_heap_sift_up(ex, task->timer_index);
+}
+
+/*
+ * Remove a task from the heap. Does nothing if it isn't in there.
+ */
+static void timer_heap_remove(executor_instance* ex, executor_task* task) {
+  slot_index index = task->timer_index;
+  if (index == TIMER_HEAP_NONE) return;
+
+  task->timer_index = TIMER_HEAP_NONE;
+  ex->timer_heap_size--;
+
+  // removed the last item, nothing to patch up
+  if (index == ex->timer_heap_size) return;
 
-  task_queue[write_index] = task;
-  task_queue_size++;
+  // move the last item into the hole, and let it find its place
+  executor_task* moved = ex->timer_heap[ex->timer_heap_size];
+  timer_heap_place(ex, moved, index);
+  timer_heap_sift_up(ex, index);
+  timer_heap_sift_down(ex, moved->timer_index);
 }
 
 /*
- * Peek the head of the task queue. Returns NULL if the queue is empty.
+ * Restore the heap order after a task's data_a was increased.
  */
-// currently unused
+static void timer_heap_postpone(executor_instance* ex, executor_task* task) {
+  if (task->timer_index == TIMER_HEAP_NONE) return;
+
+  timer_heap_sift_down(ex, task->timer_index);
+}
+
 /*
-static executor_task* task_queue_peek() {
-  if (task_queue_size == 0) {
+ * Get the timer task that activates soonest. Returns NULL if the heap is empty.
+ */
+static executor_task* timer_heap_peek(executor_instance* ex) {
+  if (ex->timer_heap_size == 0) {
     return NULL;
   }
 
-  return task_queue[task_queue_head];
+  return ex->timer_heap[0];
 }
-*/
 
 /*
- * Pop the head of the task queue. Returns NULL if the queue is empty.
+ * =========================
+ * === EVENT SUBSCRIBERS ===
+ * =========================
  */
-static executor_task* task_queue_pop() {
-  if (task_queue_size == 0) {
-    return NULL;
+
+// inverted index of event tasks: for every event, a bitmap of the task slots
+// that are listening for it (bit n of the bitmap = tasks[n])
+// this lets the tick loop dispatch an event straight to its subscribers,
+// instead of checking every task for every event that fired
+
+// the bitmaps live in executor_instance.event_subscribers
+#define TASK_BITMAP_WORDS EXECUTOR_TASK_BITMAP_WORDS
+
+/*
+ * Add or remove a task slot from the subscriber bitmaps of every event in
+ * `events`.
+ */
+static void event_subscribers_update(
+  executor_instance* ex,
+  slot_index task_slot,
+  uint32_t events,
+  bool subscribed
+) {
+  slot_index word = task_slot / 32;
+  uint32_t bit = (1UL << (task_slot % 32));
+
+  while (events != 0) {
+    uint8_t event_id = __builtin_ctz(events);
+    // clear the lowest set bit
+    events &= events - 1;
+
+    // bits past NUM_EVENTS can never fire, don't track them
+    if (event_id >= NUM_EVENTS) break;
+
+    if (subscribed) {
+      ex->event_subscribers[event_id][word] |= bit;
+    } else {
+      ex->event_subscribers[event_id][word] &= ~bit;
+    }
+  }
+}
+
+/*
+ * ==================
+ * === FREE SLOTS ===
+ * ==================
+ */
+
+// stack of task slots that aren't alive, so allocating a task is O(1)
+// instead of a scan over the whole array
+// slots are pushed when a task is cancelled, and popped when one is created
+// the stack lives in executor_instance.free_slots
+
+/*
+ * Mark every slot as free. The lowest slots are handed out first.
+ */
+static void free_slots_reset(executor_instance* ex) {
+  for (slot_index i=0; i<NUM_TASKS; i++) {
+    ex->free_slots[i] = (NUM_TASKS - 1) - i;
   }
 
-  executor_task* item = task_queue[task_queue_head];
+  ex->free_slot_count = NUM_TASKS;
+}
+
+/*
+ * Take a free slot. Returns false if every slot is in use.
+ */
+static bool free_slots_pop(executor_instance* ex, slot_index* out_slot) {
+  if (ex->free_slot_count == 0) return false;
 
-  // advance the head, wrapping around if needed
-  task_queue_head = (task_queue_head + 1) % NUM_TASKS;
-  task_queue_size--;
+  ex->free_slot_count--;
+  *out_slot = ex->free_slots[ex->free_slot_count];
 
-  return item;
+  return true;
+}
+
+/*
+ * Give a slot back once its task is no longer alive.
+ */
+static void free_slots_push(executor_instance* ex, slot_index task_slot) {
+  if (CHECK_CHEAP(ex->free_slot_count >= NUM_TASKS)) {
+    hal_panic("free_slots_push: more slots freed than exist");
+    return;
+  }
+
+  ex->free_slots[ex->free_slot_count] = task_slot;
+  ex->free_slot_count++;
 }
 
 /*
@@ -223,8 +602,9 @@ static executor_task* task_queue_pop() {
  */
 
 // task ids, as passed to the user, are split into 2 parts
-// the lowest 8 bits are an index into the tasks array, for fast access
-// the highest 24 bits are a unique number for every task created, to
+// the lowest TASK_INDEX_BITS bits (8 by default, 12 for big task tables) are
+// an index into the tasks array, for fast access
+// the remaining high bits are a unique number for every task created, to
 // essentially prevent a use-after-free
 // without it, this can happen:
 // 1. a task is allocated with an index (ex: 5)
@@ -233,38 +613,42 @@ static executor_task* task_queue_pop() {
 // 4. a new task gets assigned the same index
 // 5. user code cancels the old index again, cancelling the newly-craeted task
 
-// if you make more than 2^24 tasks over the lifetime of the program, it *will*
-// roll over and start duplicating ids, but it's just a safeguard at the end
-// of the day
+// if you make more than 2^(32 - TASK_INDEX_BITS) tasks over the lifetime of
+// the program, it *will* roll over and start duplicating ids, but it's just a
+// safeguard at the end of the day
 
-// this starts at 1 so that task id 0 can be reserved for the null id (0).
-// in addition, nonce % 2^24 can never be 0, so we do a special rollover
-uint32_t task_id_nonce = 1;
+// number of distinct nonces that fit above the index bits
+#define TASK_NONCE_LIMIT (1UL << (32 - TASK_INDEX_BITS))
 
-// generate the higher 24 bits of the task id
-// this can be ORed with the index (lower 8 bits) to make a full task ID
-static uint32_t generate_task_id() {
-  uint32_t new_task_id = task_id_nonce;
-  task_id_nonce++;
+// the nonce (executor_instance.task_id_nonce) starts at 1 so that task id 0
+// can be reserved for the null id (0).
+// in addition, nonce % TASK_NONCE_LIMIT can never be 0, so we do a special
+// rollover
+
+// generate the high (nonce) bits of the task id
+// this can be ORed with the index (low bits) to make a full task ID
+static uint32_t generate_task_id(executor_instance* ex) {
+  uint32_t new_task_id = ex->task_id_nonce;
+  ex->task_id_nonce++;
 
   // handle rollover
-  task_id_nonce %= 16777216UL;
-  if (task_id_nonce == 0) task_id_nonce++;
+  ex->task_id_nonce %= TASK_NONCE_LIMIT;
+  if (ex->task_id_nonce == 0) ex->task_id_nonce++;
 
-  return (new_task_id << 8);
+  return (new_task_id << TASK_INDEX_BITS);
 }
 
 // resolve a task handle to a pointer
-static executor_task* resolve_task_handle(task_handle handle) {
+static executor_task* resolve_task_handle(executor_instance* ex, task_handle handle) {
   // handle 0 is reserved
   if (handle == 0) return NULL;
 
   // get the index into the task
 
-  uint8_t index = handle & 0xFF;
+  slot_index index = TASK_ID_SLOT(handle);
   if (index >= NUM_TASKS) return NULL;
 
-  executor_task* task = &tasks[index];
+  executor_task* task = &ex->tasks[index];
 
   if (!task_is(task, TASK_STATUS_ALIVE)) return NULL;
   if (task->id != handle) return NULL;
@@ -282,14 +666,18 @@ static executor_task* resolve_task_handle(task_handle handle) {
  * Activate a task `num_activations` number of times. This modifies the task
  * queue, and respects the task status.
  */
-static void activate_task(executor_task* task, uint16_t num_activations) {
+static void activate_task(
+  executor_instance* ex,
+  executor_task* task,
+  uint16_t num_activations
+) {
   // sanity check
   if (num_activations == 0) return;
-  if (task == NULL) {
+  if (CHECK_FULL(task == NULL)) {
     hal_panic("activate_task: task is null");
     return;
   }
-  if (!task_is(task, TASK_STATUS_ALIVE)) {
+  if (CHECK_FULL(!task_is(task, TASK_STATUS_ALIVE))) {
     hal_panic("activate_task: task is dead");
     return;
   }
@@ -302,7 +690,7 @@ static void activate_task(executor_task* task, uint16_t num_activations) {
   int32_t possible_activations = (MAX_ACTIVATIONS - task->pending_activations);
 
   // this happens if task->pending_activations > MAX_ACTIVATIONS
-  if (possible_activations < 0) {
+  if (CHECK_FULL(possible_activations < 0)) {
     hal_panic("activate_task: possible_activations has underflowed");
     return;
   }
@@ -310,10 +698,13 @@ static void activate_task(executor_task* task, uint16_t num_activations) {
   if (num_activations > possible_activations) {
     // current behavior is to just clamp activations to the maximum possible
     task->pending_activations += possible_activations;
+    stats_add_dropped(ex, task, num_activations - possible_activations);
   } else {
     task->pending_activations += num_activations;
   }
 
+  trace_add(ex, TRACE_TASK_ACTIVATE, task->id, task->pending_activations);
+
   // handle queuing behavior
 
   // check if it's already queued
@@ -321,429 +712,1680 @@ static void activate_task(executor_task* task, uint16_t num_activations) {
     // nothing to do
     return;
   } else {
-    task_queue_push(task);
+    task_queue_push(ex, task);
     task_set(task, TASK_STATUS_ON_QUEUE);
   }
 }
 
 // cancel a task, with no sanity checks. use with caution!
-static void cancel_task(executor_task* task) {
+static void cancel_task(executor_instance* ex, executor_task* task) {
+  timer_heap_remove(ex, task);
+  if (
+    (task->type == TASK_TYPE_EVENT) ||
+    task_is(task, TASK_STATUS_WAIT_EVENT)
+  ) {
+    event_subscribers_update(ex, TASK_ID_SLOT(task->id), task->data_a, false);
+  }
   task_unset(task, TASK_STATUS_ALIVE);
   // we already zero out the task when allocating
   //memset(task, 0, sizeof(*task));
+  free_slots_push(ex, TASK_ID_SLOT(task->id));
 }
 
 /*
- * ================
- * === USER API ===
- * ================
+ * ==================
+ * === COROUTINES ===
+ * ==================
  */
 
-// not quite the user api, this still gets proxied through api_impl.c
-
-// TODO: should failures be panics or returns? currently silently ignored.
-
-// allocate a new task, with fields zeroed and id set
-// returns NULL if no slot was found
-static executor_task* allocate_task() {
-  for (uint8_t task_slot=0; task_slot<NUM_TASKS; task_slot++) {
-    if (task_is(&tasks[task_slot], TASK_STATUS_ALIVE)) continue;
-
-    executor_task* task = &tasks[task_slot];
-    // zero it out
-    memset(task, 0, sizeof(*task));
-    // mark it as alive
-    task_set(task, TASK_STATUS_ALIVE);
-    // assign the id
-    uint32_t task_id = generate_task_id() | task_slot;
-    task->id = task_id;
+// coroutines are protothread-style tasks: the target function is re-entered
+// every time the coroutine resumes, and the macros in blackbox.h jump back to
+// where it left off using the resume point in data_b
+// a coroutine is always in exactly one of these states, so it never needs
+// more than one pending activation:
+// - ready: on the queue (or paused, and will be queued on unpause)
+// - sleeping: TASK_STATUS_WAIT_TIMER, in the timer heap until data_a
+// - waiting: TASK_STATUS_WAIT_EVENT, subscribed to the events in data_a
+// - running
+// one that returns without suspending itself has finished, and is cancelled
 
-    return task;
+/*
+ * Wake a sleeping or waiting coroutine, and queue it to resume.
+ */
+static void coroutine_wake(executor_instance* ex, executor_task* task) {
+  if (task_is(task, TASK_STATUS_WAIT_EVENT)) {
+    event_subscribers_update(ex, TASK_ID_SLOT(task->id), task->data_a, false);
   }
+  timer_heap_remove(ex, task);
+  task_unset(task, TASK_STATUS_WAIT_TIMER | TASK_STATUS_WAIT_EVENT);
 
-  return NULL;
+  activate_task(ex, task, 1);
 }
 
-// create an event task. returns 0 if the creation failed
-task_handle executor_api_task_create_event(
-  task_target target,
-  uint32_t event_mask
+/*
+ * Resolve the handle of the coroutine that's currently running. Returns NULL
+ * if `handle` isn't one, as a coroutine can only suspend itself.
+ */
+static executor_task* resolve_running_coroutine(
+  executor_instance* ex,
+  task_handle handle
 ) {
-  executor_task* task = allocate_task();
-  if (task == NULL) return 0;
+  executor_task* task = resolve_task_handle(ex, handle);
 
-  task->type = TASK_TYPE_EVENT;
-  task->data_a = event_mask;
-  task->target = target;
+  if (task == NULL) return NULL;
+  if (task->type != TASK_TYPE_COROUTINE) return NULL;
+  if (!task_is(task, TASK_STATUS_RUNNING)) return NULL;
+  // it's on its way out, don't bring it back
+  if (task_is(task, TASK_STATUS_CANCEL_DEFERRED)) return NULL;
 
-  return task->id;
+  return task;
 }
 
-// create an interval task. returns 0 if the creation failed
-task_handle executor_api_task_create_interval(
-  task_target target,
-  uint32_t next_activate,
-  uint32_t interval
-) {
-  executor_task* task = allocate_task();
-  if (task == NULL) return 0;
+/*
+ * ==============
+ * === EVENTS ===
+ * ==============
+ */
 
-  task->type = TASK_TYPE_INTERVAL;
-  task->data_a = next_activate;
-  task->data_b = interval;
-  task->target = target;
+// events come from two places: the platform pushes (hardware) events into the
+// instance's event ring as they happen, and user code can emit events of its
+// own with task_emit_event. either way, they're dispatched to the subscribers
+// of the event in the EVENT SUBSCRIBERS bitmaps.
 
-  return task->id;
-}
+// the ring is drained at the start of every tick, in the order the events
+// happened, so tasks are queued in the same order as the button presses
+// that activated them
 
-// create a timeout task. returns 0 if the creation failed
-task_handle executor_api_task_create_timeout(
-  task_target target,
-  uint32_t activate_timestamp
+// emitted events are counted up in executor_instance.emitted_event_counts
+// until they're dispatched, which happens right after the task that emitted
+// them returns (or at the start of the next tick, if no task was running)
+
+/*
+ * Activate the subscribers of an event `event_activations` times.
+ * `happened_at` is the hal_micros() of the event, for the stats.
+ */
+static void dispatch_event(
+  executor_instance* ex,
+  uint8_t event_id,
+  uint8_t event_activations,
+  uint32_t happened_at
 ) {
-  executor_task* task = allocate_task();
-  if (task == NULL) return 0;
+  trace_add(ex, TRACE_EVENT, 0, event_id);
+
+  // walk the set bits of the subscriber bitmap, lowest slot first
+  for (slot_index word=0; word<TASK_BITMAP_WORDS; word++) {
+    uint32_t subscribers = ex->event_subscribers[event_id][word];
+
+    while (subscribers != 0) {
+      slot_index task_slot = (word * 32) + __builtin_ctz(subscribers);
+      // clear the lowest set bit
+      subscribers &= subscribers - 1;
+
+      executor_task* task = &ex->tasks[task_slot];
+      bool was_queued = task_is(task, TASK_STATUS_ON_QUEUE);
+
+      // remember which events fired, for task_fired_events
+      if (
+        (task->type == TASK_TYPE_EVENT) &&
+        !task_is(task, TASK_STATUS_PAUSED)
+      ) {
+        task->data_b |= (1UL << event_id);
+      }
 
-  task->type = TASK_TYPE_TIMEOUT;
-  task->data_a = activate_timestamp;
-  task->target = target;
+      if (task->type == TASK_TYPE_COROUTINE) {
+        // however many times it fired, the coroutine resumes once
+        // paused ones stay subscribed, and miss the event like any task
+        if (!task_is(task, TASK_STATUS_PAUSED)) coroutine_wake(ex, task);
+      } else {
+        activate_task(ex, task, event_activations);
+      }
 
-  return task->id;
+      // it's been waiting since the event happened, not since we got to it
+      if (!was_queued && task_is(task, TASK_STATUS_ON_QUEUE)) {
+        stats_backdate_queued(ex, task, happened_at);
+      }
+    }
+  }
 }
 
-// cancel a task
-void executor_api_task_cancel(task_handle handle) {
-  executor_task* task = resolve_task_handle(handle);
+/*
+ * Dispatch the events that were in the event ring when this was called.
+ */
+static void dispatch_ring_events(executor_instance* ex) {
+  // anything pushed while we're working on it waits for the next tick, so an
+  // interrupt storm can't keep us here forever
+  uint16_t count = event_ring_count(&ex->events);
 
-  if (task == NULL) return;
-  if (!task_is(task, TASK_STATUS_ALIVE)) return;
-  if (task_is(task, TASK_STATUS_CANCEL_DEFERRED)) return;
+  for (uint16_t i=0; i<count; i++) {
+    event_record record;
+    if (!event_ring_pop(&ex->events, &record)) break;
 
-  // if this task is running or on queue, we need to defer cancellation
-  if (task_is(task, TASK_STATUS_RUNNING) || task_is(task, TASK_STATUS_ON_QUEUE)) {
-    task_set(task, TASK_STATUS_PAUSED | TASK_STATUS_CANCEL_DEFERRED);
-  } else {
-    // destroy it now
-    cancel_task(task);
+    // the platform should never do this, but don't index out of bounds if it
+    // does
+    if (record.event_id >= NUM_EVENTS) continue;
+
+    dispatch_event(ex, record.event_id, 1, record.timestamp);
   }
 }
 
-// pause a task
-void executor_api_task_pause(task_handle handle) {
-  executor_task* task = resolve_task_handle(handle);
+/*
+ * Dispatch every event emitted since the last call.
+ */
+static void dispatch_emitted_events(executor_instance* ex) {
+  if (ex->emitted_events == 0) return;
 
-  if (task == NULL) return;
-  if (!task_is(task, TASK_STATUS_ALIVE)) return;
+  uint32_t now = stats_now();
 
-  task_set(task, TASK_STATUS_PAUSED);
+  // nothing runs while we dispatch, so nothing can emit more in the meantime
+  uint32_t events = ex->emitted_events;
+  while (events != 0) {
+    uint8_t event_id = __builtin_ctz(events);
+    // clear the lowest set bit
+    events &= events - 1;
+
+    dispatch_event(ex, event_id, ex->emitted_event_counts[event_id], now);
+  }
+
+  memset(ex->emitted_event_counts, 0, sizeof(ex->emitted_event_counts));
+  ex->emitted_events = 0;
 }
 
-// unpause a task
-void executor_api_task_unpause(task_handle handle) {
-  executor_task* task = resolve_task_handle(handle);
+/*
+ * =================
+ * === INSTANCES ===
+ * =================
+ */
 
-  if (task == NULL) return;
-  if (!task_is(task, TASK_STATUS_ALIVE)) return;
+// all the executor state lives in an executor_instance, so a process can run
+// as many black boxes as it wants (ex: for batch testing in the emulator).
+// the user api doesn't take an instance, it acts on the "current" one:
+// whichever instance is being ticked, or the default instance otherwise.
+// this is thread-local, so instances can be ticked on different threads.
 
-  task_unset(task, TASK_STATUS_PAUSED);
+// the instance behind the original, instance-less platform api
+executor_instance default_executor;
+
+// the instance the user api acts on
+static EXECUTOR_THREAD_LOCAL executor_instance* current_executor = &default_executor;
+
+/*
+ * Get the instance that the user api currently acts on.
+ */
+executor_instance* executor_current() {
+  return current_executor;
 }
 
 /*
- * ====================
- * === PLATFORM API ===
- * ====================
+ * Make the user api act on `ex`. Returns the previously current instance, so
+ * it can be restored. The tick functions do this automatically.
+ */
+executor_instance* executor_set_current(executor_instance* ex) {
+  executor_instance* previous = current_executor;
+  current_executor = ex;
+
+  return previous;
+}
+
+/*
+ * ================
+ * === TIMEBASE ===
+ * ================
  */
 
-// last time the event loop tick was called
-uint32_t last_tick_timestamp;
+// the executor runs on a 64-bit microsecond clock. platforms pass it in when
+// they tick the loop, but user code also needs "now" in between ticks (to
+// schedule timers), and all the hal gives us there is the 32-bit hal_micros(),
+// which wraps around every ~71 minutes.
+// so, every tick anchors the 64-bit time against hal_micros(), and "now" is
+// the anchor plus however much hal_micros() has moved since. that's only
+// wrong if a single task runs for over an hour, which has bigger problems.
 
-// if the executor has been initalized
-bool is_initialized = false;
+// the anchors live in executor_instance.last_tick_*
 
 /*
-// awful debugging code
-// at least it looks cool
-static void debug_print_task_state() {
-  printf("task state:\n");
-  for (uint8_t i=0; i<NUM_TASKS; i++) {
-    printf("  %02hx: ", i);
-    executor_task* task = &tasks[i];
-    if (!task_is(task, TASK_STATUS_ALIVE)) {
-      printf("(free)\n");
-      continue;
-    }
+ * Get the current time of an instance, in microseconds since it was started.
+ */
+uint64_t executor_instance_micros(executor_instance* ex) {
+  uint32_t elapsed = hal_micros() - ex->last_tick_hal_micros;
 
-    printf("id=%04x ", task->id);
+  return ex->last_tick_timestamp + elapsed;
+}
 
-    if (task->type == TASK_TYPE_EVENT) {
-      printf("EVNT ");
-    } else if (task->type == TASK_TYPE_TIMEOUT) {
-      printf("TOUT ");
-    } else if (task->type == TASK_TYPE_INTERVAL) {
-      printf("INTR ");
-    } else {
-      printf("???? ");
-    }
+/*
+ * Get the current time of the current instance, in microseconds since it was
+ * started.
+ */
+uint64_t executor_micros() {
+  return executor_instance_micros(current_executor);
+}
 
-    if (task_is(task, TASK_STATUS_ALIVE)) {
-      printf("a");
-    } else {
-      printf("-");
+// turn a 32-bit millisecond timestamp (that wraps every ~49.7 days) into
+// 64-bit microseconds. returns false if the time went backwards.
+static bool unwrap_millis(
+  executor_instance* ex,
+  uint32_t current_time,
+  uint64_t* out_time
+) {
+  uint32_t elapsed = current_time - ex->last_tick_millis;
+
+  // anything over half the range is much more likely to be time going
+  // backwards than us not being ticked for 24 days
+  if (elapsed > 0x80000000UL) return false;
+
+  ex->last_tick_millis = current_time;
+  ex->last_tick_millis_64 += elapsed;
+
+  *out_time = ex->last_tick_millis_64 * 1000;
+
+  return true;
+}
+
+// turn a 64-bit microsecond wakeup time back into the millisecond api's
+// 32-bit timestamps, preserving the special values
+static uint32_t wrap_millis(executor_instance* ex, uint64_t wakeup_time) {
+  if (wakeup_time == 0) return 0;
+  if (wakeup_time == TIMESTAMP_MAX) return TIMESTAMP_MAX_MS;
+
+  // round up, waking up early would just waste a tick
+  uint64_t wakeup_millis_64 = (wakeup_time + 999) / 1000;
+
+  // rebase it onto the platform's (wrapping) millisecond clock
+  uint32_t wakeup_millis = ex->last_tick_millis + (uint32_t) (
+    wakeup_millis_64 - ex->last_tick_millis_64
+  );
+
+  // don't let a real time be mistaken for one of the special values
+  if (wakeup_millis == 0) wakeup_millis = 1;
+  if (wakeup_millis == TIMESTAMP_MAX_MS) wakeup_millis = TIMESTAMP_MAX_MS - 1;
+
+  return wakeup_millis;
+}
+
+/*
+ * ================
+ * === USER API ===
+ * ================
+ */
+
+// not quite the user api, this still gets proxied through api_impl.c
+
+// TODO: should failures be panics or returns? currently silently ignored.
+
+// allocate a new task, with fields zeroed and id set
+// returns NULL if no slot was found
+static executor_task* allocate_task(executor_instance* ex) {
+  slot_index task_slot;
+  if (!free_slots_pop(ex, &task_slot)) return NULL;
+
+  executor_task* task = &ex->tasks[task_slot];
+
+  if (CHECK_FULL(task_is(task, TASK_STATUS_ALIVE))) {
+    hal_panic("allocate_task: free slot holds a live task");
+    return NULL;
+  }
+
+  // zero it out
+  memset(task, 0, sizeof(*task));
+  // mark it as alive
+  task_set(task, TASK_STATUS_ALIVE);
+  task->timer_index = TIMER_HEAP_NONE;
+  // assign the id
+  uint32_t task_id = generate_task_id(ex) | task_slot;
+  task->id = task_id;
+
+  ex->slot_groups[task_slot] = ex->default_group;
+
+  stats_reset(ex, task_slot);
+
+  return task;
+}
+
+// create an event task. returns 0 if the creation failed
+task_handle executor_api_task_create_event(
+  task_target target,
+  uint32_t event_mask
+) {
+  executor_instance* ex = current_executor;
+
+  executor_task* task = allocate_task(ex);
+  if (task == NULL) return 0;
+
+  task->type = TASK_TYPE_EVENT;
+  // events are user input, so they jump ahead of timers by default
+  task->priority = TASK_PRIORITY_HIGH;
+  task->data_a = event_mask;
+  task->target = target;
+
+  event_subscribers_update(ex, TASK_ID_SLOT(task->id), event_mask, true);
+
+  return task->id;
+}
+
+// create an interval task. returns 0 if the creation failed
+task_handle executor_api_task_create_interval(
+  task_target target,
+  uint64_t next_activate,
+  uint64_t interval
+) {
+  executor_instance* ex = current_executor;
+
+  executor_task* task = allocate_task(ex);
+  if (task == NULL) return 0;
+
+  task->type = TASK_TYPE_INTERVAL;
+  task->priority = TASK_PRIORITY_NORMAL;
+  task->data_a = next_activate;
+  task->data_b = interval;
+  task->target = target;
+
+  timer_heap_push(ex, task);
+
+  return task->id;
+}
+
+// create a timeout task. returns 0 if the creation failed
+task_handle executor_api_task_create_timeout(
+  task_target target,
+  uint64_t activate_timestamp
+) {
+  executor_instance* ex = current_executor;
+
+  executor_task* task = allocate_task(ex);
+  if (task == NULL) return 0;
+
+  task->type = TASK_TYPE_TIMEOUT;
+  task->priority = TASK_PRIORITY_NORMAL;
+  task->data_a = activate_timestamp;
+  task->target = target;
+
+  timer_heap_push(ex, task);
+
+  return task->id;
+}
+
+// create a coroutine task, which starts running on the next tick. returns 0
+// if the creation failed
+task_handle executor_api_task_create_coroutine(task_target target) {
+  executor_instance* ex = current_executor;
+
+  executor_task* task = allocate_task(ex);
+  if (task == NULL) return 0;
+
+  task->type = TASK_TYPE_COROUTINE;
+  task->priority = TASK_PRIORITY_NORMAL;
+  // start from the top
+  task->data_b = 0;
+  task->target = target;
+
+  activate_task(ex, task, 1);
+
+  return task->id;
+}
+
+// get where a coroutine should resume from (0 = the start)
+uint32_t executor_api_task_coroutine_resume_point(task_handle handle) {
+  executor_instance* ex = current_executor;
+
+  executor_task* task = resolve_task_handle(ex, handle);
+
+  if (task == NULL) return 0;
+  if (task->type != TASK_TYPE_COROUTINE) return 0;
+
+  return (uint32_t) task->data_b;
+}
+
+// suspend the running coroutine, and queue it to resume from `resume_point`
+// after everything that's already waiting to run at its priority
+void executor_api_task_coroutine_yield(task_handle handle, uint32_t resume_point) {
+  executor_instance* ex = current_executor;
+
+  executor_task* task = resolve_running_coroutine(ex, handle);
+  if (task == NULL) return;
+
+  task->data_b = resume_point;
+
+  // if it's paused this does nothing, and unpausing it will queue it instead
+  activate_task(ex, task, 1);
+}
+
+// suspend the running coroutine until `wake_timestamp`, then resume it from
+// `resume_point`
+void executor_api_task_coroutine_sleep(
+  task_handle handle,
+  uint32_t resume_point,
+  uint64_t wake_timestamp
+) {
+  executor_instance* ex = current_executor;
+
+  executor_task* task = resolve_running_coroutine(ex, handle);
+  if (task == NULL) return;
+
+  task->data_b = resume_point;
+  task->data_a = wake_timestamp;
+  task_set(task, TASK_STATUS_WAIT_TIMER);
+
+  // paused coroutines get put in the heap when they're unpaused
+  if (!task_is(task, TASK_STATUS_PAUSED)) {
+    timer_heap_push(ex, task);
+  }
+}
+
+// suspend the running coroutine until any of the events in `event_mask`
+// happen, then resume it from `resume_point`
+void executor_api_task_coroutine_wait_event(
+  task_handle handle,
+  uint32_t resume_point,
+  uint32_t event_mask
+) {
+  executor_instance* ex = current_executor;
+
+  executor_task* task = resolve_running_coroutine(ex, handle);
+  if (task == NULL) return;
+
+  task->data_b = resume_point;
+  task->data_a = event_mask;
+  task_set(task, TASK_STATUS_WAIT_EVENT);
+
+  event_subscribers_update(ex, TASK_ID_SLOT(task->id), event_mask, true);
+}
+
+// cancel a live task, now if it's safe to, otherwise once it's off the queue
+static void request_cancel(executor_instance* ex, executor_task* task) {
+  if (task_is(task, TASK_STATUS_CANCEL_DEFERRED)) return;
+
+  // if this task is running or on queue, we need to defer cancellation
+  if (task_is(task, TASK_STATUS_RUNNING) || task_is(task, TASK_STATUS_ON_QUEUE)) {
+    task_set(task, TASK_STATUS_PAUSED | TASK_STATUS_CANCEL_DEFERRED);
+    // it won't be activated again, so stop tracking its timer
+    timer_heap_remove(ex, task);
+  } else {
+    // destroy it now
+    cancel_task(ex, task);
+  }
+}
+
+// cancel a task
+void executor_api_task_cancel(task_handle handle) {
+  executor_instance* ex = current_executor;
+
+  executor_task* task = resolve_task_handle(ex, handle);
+
+  if (task == NULL) return;
+  if (!task_is(task, TASK_STATUS_ALIVE)) return;
+
+  request_cancel(ex, task);
+}
+
+// activate a task once, as if one of its events had fired
+// coroutines are only woken if they're sleeping or waiting, since a ready
+// one is going to run anyways
+void executor_api_task_activate(task_handle handle) {
+  executor_instance* ex = current_executor;
+
+  executor_task* task = resolve_task_handle(ex, handle);
+
+  if (task == NULL) return;
+  if (!task_is(task, TASK_STATUS_ALIVE)) return;
+  if (task_is(task, TASK_STATUS_CANCEL_DEFERRED)) return;
+
+  if (task->type == TASK_TYPE_COROUTINE) {
+    if (task_is(task, TASK_STATUS_PAUSED)) return;
+
+    if (
+      task_is(task, TASK_STATUS_WAIT_TIMER) ||
+      task_is(task, TASK_STATUS_WAIT_EVENT)
+    ) {
+      coroutine_wake(ex, task);
     }
 
-    if (task_is(task, TASK_STATUS_ON_QUEUE)) {
-      printf("q");
-    } else {
-      printf("-");
+    return;
+  }
+
+  activate_task(ex, task, 1);
+}
+
+// fire every event in `event_mask` once. subscribers are activated when the
+// running task returns, or on the next tick if no task is running
+void executor_api_emit_event(uint32_t event_mask) {
+  executor_instance* ex = current_executor;
+
+  while (event_mask != 0) {
+    uint8_t event_id = __builtin_ctz(event_mask);
+    // clear the lowest set bit
+    event_mask &= event_mask - 1;
+
+    // bits past NUM_EVENTS can never have subscribers
+    if (event_id >= NUM_EVENTS) break;
+
+    // saturate instead of wrapping around, like the platform's counters
+    if (ex->emitted_event_counts[event_id] < 0xFF) {
+      ex->emitted_event_counts[event_id]++;
     }
+    ex->emitted_events |= (1UL << event_id);
+  }
+}
 
-    if (task_is(task, TASK_STATUS_RUNNING)) {
-      printf("r");
-    } else {
-      printf("-");
+// make a task take all of its pending activations in one run
+void executor_api_task_set_batched(task_handle handle, bool batched) {
+  executor_instance* ex = current_executor;
+
+  executor_task* task = resolve_task_handle(ex, handle);
+
+  if (task == NULL) return;
+  if (!task_is(task, TASK_STATUS_ALIVE)) return;
+
+  if (batched) {
+    task_set(task, TASK_STATUS_BATCHED);
+  } else {
+    task_unset(task, TASK_STATUS_BATCHED);
+  }
+}
+
+// get how many activations the running task is handling in this run
+// returns 0 if no task is running
+uint16_t executor_api_task_activation_count() {
+  executor_instance* ex = current_executor;
+
+  return ex->running_activations;
+}
+
+// get which events fired for the running task since it last ran
+// returns 0 if no task is running, or the running task isn't an event task
+uint32_t executor_api_task_fired_events() {
+  executor_instance* ex = current_executor;
+
+  return ex->running_events;
+}
+
+// pause a live task
+static void pause_task(executor_instance* ex, executor_task* task) {
+  task_set(task, TASK_STATUS_PAUSED);
+  // paused timers shouldn't cause us to tick earlier
+  timer_heap_remove(ex, task);
+}
+
+// unpause a live task, giving it back its timer
+static void unpause_task(executor_instance* ex, executor_task* task) {
+  if (!task_is(task, TASK_STATUS_PAUSED)) return;
+
+  task_unset(task, TASK_STATUS_PAUSED);
+
+  // tasks on their way out don't get their timer back
+  if (task_is(task, TASK_STATUS_CANCEL_DEFERRED)) return;
+
+  if (task->type == TASK_TYPE_INTERVAL) {
+    // skip over the activations that were missed while paused, keeping the
+    // phase of the interval the same
+    if (task->data_a <= ex->last_tick_timestamp) {
+      uint64_t missed = (ex->last_tick_timestamp - task->data_a) / task->data_b;
+      task->data_a += (missed + 1) * task->data_b;
     }
+  }
 
-    if (task_is(task, TASK_STATUS_PAUSED)) {
-      printf("p");
-    } else {
-      printf("-");
+  if (
+    (task->type == TASK_TYPE_INTERVAL) ||
+    (task->type == TASK_TYPE_TIMEOUT) ||
+    task_is(task, TASK_STATUS_WAIT_TIMER)
+  ) {
+    timer_heap_push(ex, task);
+  }
+
+  // a coroutine that was ready to resume lost its activation while paused,
+  // so queue it again (waiting ones are still subscribed to their events)
+  if (
+    (task->type == TASK_TYPE_COROUTINE) &&
+    !task_is(task, TASK_STATUS_WAIT_TIMER) &&
+    !task_is(task, TASK_STATUS_WAIT_EVENT) &&
+    !task_is(task, TASK_STATUS_ON_QUEUE) &&
+    !task_is(task, TASK_STATUS_RUNNING)
+  ) {
+    task->pending_activations = 0;
+    activate_task(ex, task, 1);
+  }
+}
+
+// pause a task
+void executor_api_task_pause(task_handle handle) {
+  executor_instance* ex = current_executor;
+
+  executor_task* task = resolve_task_handle(ex, handle);
+
+  if (task == NULL) return;
+  if (!task_is(task, TASK_STATUS_ALIVE)) return;
+
+  pause_task(ex, task);
+}
+
+// unpause a task
+void executor_api_task_unpause(task_handle handle) {
+  executor_instance* ex = current_executor;
+
+  executor_task* task = resolve_task_handle(ex, handle);
+
+  if (task == NULL) return;
+  if (!task_is(task, TASK_STATUS_ALIVE)) return;
+
+  unpause_task(ex, task);
+}
+
+// move a task into a group
+void executor_api_task_set_group(task_handle handle, task_group group) {
+  executor_instance* ex = current_executor;
+
+  executor_task* task = resolve_task_handle(ex, handle);
+
+  if (task == NULL) return;
+  if (!task_is(task, TASK_STATUS_ALIVE)) return;
+  if (group >= TASK_GROUP_COUNT) return;
+
+  ex->slot_groups[TASK_ID_SLOT(task->id)] = group;
+}
+
+// change the group that new tasks are put in
+// returns the previous one, so it can be put back afterwards
+task_group executor_api_task_set_default_group(task_group group) {
+  executor_instance* ex = current_executor;
+
+  task_group previous = ex->default_group;
+  if (group < TASK_GROUP_COUNT) ex->default_group = group;
+
+  return previous;
+}
+
+// the group operations make a single pass over the task table, instead of
+// resolving a handle per task. ungrouped tasks are never touched.
+
+// cancel every task in the groups in `group_mask`
+void executor_api_task_group_cancel(task_group_mask group_mask) {
+  executor_instance* ex = current_executor;
+
+  group_mask &= ~TASK_GROUP_MASK(TASK_GROUP_NONE);
+  if (group_mask == 0) return;
+
+  for (slot_index i = 0; i < NUM_TASKS; i++) {
+    executor_task* task = &ex->tasks[i];
+
+    if (!task_is(task, TASK_STATUS_ALIVE)) continue;
+    if (!(group_mask & TASK_GROUP_MASK(ex->slot_groups[i]))) continue;
+
+    request_cancel(ex, task);
+  }
+}
+
+// pause every task in the groups in `group_mask`
+void executor_api_task_group_pause(task_group_mask group_mask) {
+  executor_instance* ex = current_executor;
+
+  group_mask &= ~TASK_GROUP_MASK(TASK_GROUP_NONE);
+  if (group_mask == 0) return;
+
+  for (slot_index i = 0; i < NUM_TASKS; i++) {
+    executor_task* task = &ex->tasks[i];
+
+    if (!task_is(task, TASK_STATUS_ALIVE)) continue;
+    if (!(group_mask & TASK_GROUP_MASK(ex->slot_groups[i]))) continue;
+
+    pause_task(ex, task);
+  }
+}
+
+// unpause every task in the groups in `group_mask`
+void executor_api_task_group_unpause(task_group_mask group_mask) {
+  executor_instance* ex = current_executor;
+
+  group_mask &= ~TASK_GROUP_MASK(TASK_GROUP_NONE);
+  if (group_mask == 0) return;
+
+  for (slot_index i = 0; i < NUM_TASKS; i++) {
+    executor_task* task = &ex->tasks[i];
+
+    if (!task_is(task, TASK_STATUS_ALIVE)) continue;
+    if (!(group_mask & TASK_GROUP_MASK(ex->slot_groups[i]))) continue;
+
+    unpause_task(ex, task);
+  }
+}
+
+// change the priority of a task
+// if the task is already on the queue, this takes effect the next time it's
+// queued
+void executor_api_task_set_priority(task_handle handle, task_priority priority) {
+  executor_instance* ex = current_executor;
+
+  executor_task* task = resolve_task_handle(ex, handle);
+
+  if (task == NULL) return;
+  if (!task_is(task, TASK_STATUS_ALIVE)) return;
+  if (priority >= NUM_PRIORITIES) return;
+
+  task->priority = priority;
+}
+
+// change what an interval task does when it misses activations
+void executor_api_task_set_catch_up(task_handle handle, task_catch_up catch_up) {
+  executor_instance* ex = current_executor;
+
+  executor_task* task = resolve_task_handle(ex, handle);
+
+  if (task == NULL) return;
+  if (!task_is(task, TASK_STATUS_ALIVE)) return;
+  if (catch_up > TASK_CATCH_UP_SKIP) return;
+
+  task->catch_up = catch_up;
+}
+
+/*
+ * ====================
+ * === PLATFORM API ===
+ * ====================
+ */
+
+// awful debugging code
+// at least it looks cool
+
+// format a line and send it to the console
+static void debug_print_line(const char* format, ...) {
+  char line[128];
+
+  va_list args;
+  va_start(args, format);
+  vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+
+  hal_console_write(line);
+}
+
+// print the state of every live task (and its stats, if enabled) and the queue
+static void debug_print_task_state(executor_instance* ex) {
+  debug_print_line("task state (%u/%u slots used):", NUM_TASKS - ex->free_slot_count, NUM_TASKS);
+
+  for (slot_index i=0; i<NUM_TASKS; i++) {
+    executor_task* task = &ex->tasks[i];
+    if (!task_is(task, TASK_STATUS_ALIVE)) continue;
+
+    const char* type_name = "????";
+    if (task->type == TASK_TYPE_EVENT) {
+      type_name = "EVNT";
+    } else if (task->type == TASK_TYPE_TIMEOUT) {
+      type_name = "TOUT";
+    } else if (task->type == TASK_TYPE_INTERVAL) {
+      type_name = "INTR";
+    } else if (task->type == TASK_TYPE_COROUTINE) {
+      type_name = "CORO";
     }
 
-    if (task_is(task, TASK_STATUS_CANCEL_DEFERRED)) {
-      printf("c");
-    } else {
-      printf("-");
+    debug_print_line(
+      "  %03x: id=%08lx %s %c%c%c%c%c%c%c%c p%u P=%05u a=%llu b=%llu",
+      i,
+      (unsigned long) task->id,
+      type_name,
+      task_is(task, TASK_STATUS_ALIVE) ? 'a' : '-',
+      task_is(task, TASK_STATUS_ON_QUEUE) ? 'q' : '-',
+      task_is(task, TASK_STATUS_RUNNING) ? 'r' : '-',
+      task_is(task, TASK_STATUS_PAUSED) ? 'p' : '-',
+      task_is(task, TASK_STATUS_CANCEL_DEFERRED) ? 'c' : '-',
+      task_is(task, TASK_STATUS_WAIT_TIMER) ? 't' : '-',
+      task_is(task, TASK_STATUS_WAIT_EVENT) ? 'e' : '-',
+      task_is(task, TASK_STATUS_BATCHED) ? 'b' : '-',
+      task->priority,
+      task->pending_activations,
+      (unsigned long long) task->data_a,
+      (unsigned long long) task->data_b
+    );
+
+#if EXECUTOR_ENABLE_STATS
+    task_stats* stats = &ex->slot_stats[i];
+    uint32_t average_run_time = 0;
+    if (stats->run_count > 0) {
+      average_run_time = stats->total_run_time / stats->run_count;
     }
 
-    printf(" P=%04u a=%u b=%u\n", task->pending_activations, task->data_a, task->data_b);
+    debug_print_line(
+      "       runs=%lu avg=%luus max=%luus max_latency=%luus dropped=%lu",
+      (unsigned long) stats->run_count,
+      (unsigned long) average_run_time,
+      (unsigned long) stats->max_run_time,
+      (unsigned long) stats->max_latency,
+      (unsigned long) stats->dropped_activations
+    );
+#endif
   }
 
-  printf("task queue:\n");
+  debug_print_line(
+    "events dropped (ring full): %lu",
+    (unsigned long) event_ring_dropped(&ex->events)
+  );
 
-  if (task_queue_size == 0) {
-    printf("  (empty)");
+  debug_print_line("task queue:");
+
+  if (ex->task_queue_size == 0) {
+    debug_print_line("  (empty)");
   } else {
-    for (uint8_t i=0; i<task_queue_size; i++) {
-      executor_task* task = task_queue[(task_queue_head + i) % NUM_TASKS];
+    for (uint8_t level=0; level<NUM_PRIORITIES; level++) {
+      for (uint16_t i=0; i<ex->task_queue_level_size[level]; i++) {
+        executor_task* task = ex->task_queue[level][
+          (ex->task_queue_level_head[level] + i) % QUEUE_SIZE
+        ];
 
-      printf("  id=%04x\n", task->id);
+        debug_print_line("  p%u id=%08lx", level, (unsigned long) task->id);
+      }
     }
   }
 }
-*/
+
+// print the state of the executor to the debug console
+void executor_api_debug_print_tasks() {
+  executor_instance* ex = current_executor;
+
+  debug_print_task_state(ex);
+}
+
+// add a record for something outside the executor (ex: a hal call) to the
+// trace. it lands inside the run of whichever task made it.
+void executor_api_trace(trace_type type, uint16_t value) {
+  trace_add(current_executor, type, 0, value);
+}
+
+// copy the stats for a task. returns false if stats are disabled or the
+// handle is invalid
+bool executor_api_task_get_stats(task_handle handle, task_stats* out_stats) {
+  executor_instance* ex = current_executor;
+
+#if EXECUTOR_ENABLE_STATS
+  executor_task* task = resolve_task_handle(ex, handle);
+
+  if (task == NULL) return false;
+  if (out_stats == NULL) return false;
+
+  *out_stats = ex->slot_stats[TASK_ID_SLOT(task->id)];
+
+  return true;
+#else
+  (void) ex;
+  (void) handle;
+  (void) out_stats;
+
+  return false;
+#endif
+}
 
 /*
- * Initialize the executor. This needs to be run before the loop is ticked.
+ * Initialize an executor instance. This needs to be run before the instance is
+ * ticked. Any tasks it had are forgotten.
  */
-void executor_init() {
-  memset(&tasks, 0, sizeof(tasks));
+void executor_instance_init(executor_instance* ex) {
+  memset(&ex->tasks, 0, sizeof(ex->tasks));
+
+  memset(&ex->task_queue, 0, sizeof(ex->task_queue));
+  memset(&ex->task_queue_level_size, 0, sizeof(ex->task_queue_level_size));
+  memset(&ex->task_queue_level_head, 0, sizeof(ex->task_queue_level_head));
+  ex->task_queue_levels = 0;
+  ex->task_queue_size = 0;
+
+  memset(&ex->timer_heap, 0, sizeof(ex->timer_heap));
+  ex->timer_heap_size = 0;
+
+  event_ring_init(&ex->events);
 
-  memset(&task_queue, 0, sizeof(task_queue));
-  task_queue_size = 0;
-  task_queue_head = 0;
+  memset(&ex->event_subscribers, 0, sizeof(ex->event_subscribers));
 
-  last_tick_timestamp = 0;
+  memset(&ex->emitted_event_counts, 0, sizeof(ex->emitted_event_counts));
+  ex->emitted_events = 0;
+
+  free_slots_reset(ex);
+
+  memset(&ex->slot_groups, 0, sizeof(ex->slot_groups));
+  ex->default_group = TASK_GROUP_NONE;
+
+  ex->task_id_nonce = 1;
+
+  // assume we're started shortly after boot, so the platform's 64-bit clock
+  // and hal_micros() still agree.
+  // the anchor is rounded down to a whole millisecond, since the millisecond
+  // api only sees whole milliseconds: otherwise a first tick in the same
+  // millisecond as init would look like time going backwards.
+  uint32_t now = hal_micros();
+  ex->last_tick_millis = now / 1000;
+  ex->last_tick_millis_64 = ex->last_tick_millis;
+  ex->last_tick_timestamp = ex->last_tick_millis_64 * 1000;
+  ex->last_tick_hal_micros = now - (now % 1000);
+
+  ex->running_activations = 0;
+  ex->running_events = 0;
+
+  // whatever the hal is showing, the first present should replace it
+  memset(&ex->framebuffer_rows, 0, sizeof(ex->framebuffer_rows));
+  ex->framebuffer_dirty = FRAMEBUFFER_ALL_ROWS;
+
+  ex->user_data = NULL;
+
+#if EXECUTOR_ENABLE_TRACE
+  trace_ring_init(&ex->trace);
+#endif
+}
+
+/*
+ * Record that an event happened, to be dispatched on the next tick of `ex`.
+ * Safe to call from an interrupt handler (the ring's single producer).
+ */
+bool executor_instance_push_event(executor_instance* ex, uint8_t event_id) {
+  return event_ring_push(&ex->events, event_id, hal_micros());
+}
+
+/*
+ * Record that an event happened, on the default instance.
+ */
+bool executor_push_event(uint8_t event_id) {
+  return executor_instance_push_event(&default_executor, event_id);
 }
 
 /*
- * Run a tick of the event loop. Takes in the current timestamp, and an array
- * of the number of times events have occurred since the last tick.
- * 
- * Returns the timestamp that the executor should be ticked at next, assuming
- * no events happen before then. Returns 0xFFFFFFFF if no timers require the 
- * event loop to be ticked. Returns 0 if the tick loop should be invoked as
- * soon as possible.
+ * Move up to `max_records` of the oldest trace records of `ex` into
+ * `out_records`. Returns how many were moved.
  */
-uint32_t executor_tick_loop(uint32_t current_time, uint8_t event_counts_in[NUM_EVENTS]) {
+size_t executor_instance_trace_drain(
+  executor_instance* ex,
+  trace_record* out_records,
+  size_t max_records
+) {
+#if EXECUTOR_ENABLE_TRACE
+  return trace_ring_drain(&ex->trace, out_records, max_records);
+#else
+  (void) ex;
+  (void) out_records;
+  (void) max_records;
+
+  return 0;
+#endif
+}
+
+/*
+ * Get the number of trace records of `ex` that were overwritten before they
+ * could be drained.
+ */
+uint32_t executor_instance_trace_dropped(executor_instance* ex) {
+#if EXECUTOR_ENABLE_TRACE
+  return ex->trace.dropped;
+#else
+  (void) ex;
+
+  return 0;
+#endif
+}
+
+/*
+ * Drain the trace of the default instance.
+ */
+size_t executor_trace_drain(trace_record* out_records, size_t max_records) {
+  return executor_instance_trace_drain(&default_executor, out_records, max_records);
+}
+
+/*
+ * Initialize the default executor instance. This needs to be run before the
+ * loop is ticked.
+ */
+void executor_init() {
+  executor_instance_init(&default_executor);
+}
+
+/*
+ * Steps 0-2 of a tick: sanity check the time, then activate every task whose
+ * event fired or whose timer is due. Returns false if it had to panic.
+ */
+static bool tick_activate_tasks(
+  executor_instance* ex,
+  uint64_t current_time
+) {
   // step 0: sanity check
-  if (current_time < last_tick_timestamp) {
-    hal_panic("executor_tick_loop: time went backwards! did the global timer overflow?");
-    return TIMESTAMP_MAX;
+  if (CHECK_CHEAP(current_time < ex->last_tick_timestamp)) {
+    hal_panic("executor_tick_loop: time went backwards!");
+    return false;
   }
 
-  // step 1: copy the event counts
-  // why pass in events? it's safer than having an interrupt poke the executor
-  // and less race conditions if you move the responsibility to plat_main
-
-  // number of times each event has been fired since we were last ticked
-  uint8_t event_counts[NUM_EVENTS];
+  ex->last_tick_timestamp = current_time;
+  ex->last_tick_hal_micros = hal_micros();
 
-  // critical section: we cannot have event_counts change while we work on it
-  // copy the entire thing to a local variable
-  hal_critical_enter();
-  memcpy(event_counts, event_counts_in, sizeof(event_counts));
-  hal_critical_exit();
+  // step 1: (nothing to do)
+  // events used to be copied in from the platform here, under a critical
+  // section. now interrupts push them straight into the lock-free event ring.
 
   // step 2: calculate activations for tasks
 
   // step 2.1: handle event-based activations
-  for (uint8_t event_id=0; event_id<NUM_EVENTS; event_id++) {
-    uint8_t event_activations = event_counts[event_id];
+  // events emitted by user code since the last tick go out with them
+  dispatch_ring_events(ex);
+  dispatch_emitted_events(ex);
 
-    if (event_activations == 0) continue;
+  // step 2.2: handle timer-based activations
+  // the heap is ordered by next activation, so just keep taking the soonest
+  // timer until we hit one that isn't due yet
+  while (true) {
+    executor_task* task = timer_heap_peek(ex);
 
-    uint32_t event_bitmask = (1 << event_id);
+    if (task == NULL) break;
+    if (current_time < task->data_a) break;
+    // TIMESTAMP_MAX means "never", see the end of the interval case
+    if (task->data_a == TIMESTAMP_MAX) break;
 
-    // find tasks that match this event
-    for (uint8_t i=0; i<NUM_TASKS; i++) {
-      executor_task* task = &tasks[i];
+    if ((task->type) == TASK_TYPE_TIMEOUT) {
+      // activate this task
+      activate_task(ex, task, 1);
+      // take it out of the heap so it doesn't activate again before it runs
+      timer_heap_remove(ex, task);
+      // mark the task to be deleted after next execution
+      task_set(task, TASK_STATUS_CANCEL_DEFERRED);
+    } else if ((task->type) == TASK_TYPE_INTERVAL) {
+      // it needs to be activated!
+
+      uint64_t interval_at = task->data_a;
+      uint64_t interval_rate = task->data_b;
+
+      // avoid a possible division by zero
+      if (CHECK_CHEAP(interval_rate == 0)) {
+        hal_panic("executor_tick_loop: encountered a task interval_rate of 0");
+        return false;
+      }
 
-      if (!task_is(task, TASK_STATUS_ALIVE)) continue;
-      if ((task->type) != TASK_TYPE_EVENT) continue;
+      // handle "overdue" activations, ones that should've happened by now
+      // this is 64 bits wide, so it can't overflow for any current_time
+      uint64_t overdue_activations = (current_time - interval_at) / interval_rate;
+
+      // how many times to actually run it, depending on the catch up policy
+      uint16_t run_activations;
+      if (task->catch_up == TASK_CATCH_UP_COALESCE) {
+        // however late we are, it only runs once
+        run_activations = 1;
+      } else if (task->catch_up == TASK_CATCH_UP_SKIP) {
+        // if we missed a whole period, drop everything and wait for the next
+        run_activations = (overdue_activations == 0) ? 1 : 0;
+      } else if (overdue_activations < MAX_ACTIVATIONS) {
+        // 1 activation, and however many more if we're behind schedule
+        run_activations = 1 + overdue_activations;
+      } else {
+        // activate_task would clamp this anyways, but it has to fit in the
+        // uint16_t first
+        stats_add_dropped(ex, task, (uint32_t) (overdue_activations - (MAX_ACTIVATIONS - 1)));
+        run_activations = MAX_ACTIVATIONS;
+      }
 
-      // check if task is listening for this event
-      if ((task->data_a & event_bitmask) != 0) {
-        activate_task(task, event_activations);
+      // activate the task
+      activate_task(ex, task, run_activations);
+
+      // bump the next time we should check it
+      // we only ever increment by multiples of interval_rate, to ensure that
+      // the "phase" of the timing stays correct
+      // a timer that would go past the end of time just parks at
+      // TIMESTAMP_MAX instead of wrapping around
+      uint64_t periods = overdue_activations + 1;
+      if (periods > (TIMESTAMP_MAX - interval_at) / interval_rate) {
+        task->data_a = TIMESTAMP_MAX;
+      } else {
+        task->data_a = interval_at + periods * interval_rate;
       }
+      timer_heap_postpone(ex, task);
+    } else if ((task->type) == TASK_TYPE_COROUTINE) {
+      // done sleeping, this also takes it out of the heap
+      coroutine_wake(ex, task);
+    } else {
+      hal_panic("executor_tick_loop: non-timer task in the timer heap");
+      return false;
     }
   }
 
-  // step 2.2: handle timer-based activations
-  for (uint8_t i=0; i<NUM_TASKS; i++) {
-    executor_task* task = &tasks[i];
+  return true;
+}
 
-    if (!task_is(task, TASK_STATUS_ALIVE)) continue;
+/*
+ * Step 3 of a tick: pick a task from the queue and execute it. Does nothing if
+ * the queue is empty. Returns false if it had to panic.
+ */
+static bool tick_run_queued_task(executor_instance* ex) {
+  executor_task* task = task_queue_pop(ex);
 
-    if ((task->type) == TASK_TYPE_TIMEOUT) {
-      uint32_t timeout_at = task->data_a;
+  if (task == NULL) return true;
 
-      if (current_time >= timeout_at) {
-        // activate this task
-        activate_task(task, 1);
-        // set the timeout to the max so it doesn't activate again before it runs
-        task->data_a = TIMESTAMP_MAX;
-        // mark the task to be deleted after next execution
-        task_set(task, TASK_STATUS_CANCEL_DEFERRED);
-      }
+  // sanity check first
+  // !TASK_STATUS_ALIVE -> if you want to cancel a task on the queue, just
+  // add TASK_STATUS_DEFERRED_CANCEL and wait for it to work its way through
+  // !TASK_STATUS_ON_QUEUE -> this should never happen...
+  if (CHECK_FULL(!task_is(task, TASK_STATUS_ALIVE | TASK_STATUS_ON_QUEUE))) {
+    hal_panic("executor_tick_loop: task from queue has invalid flags");
+    return false;
+  }
+
+  // it's not on the queue anymore
+  task_unset(task, TASK_STATUS_ON_QUEUE);
+
+  // if this task is paused (but is still in the queue from a previous activation)
+  // ignore it
+  if (task_is(task, TASK_STATUS_PAUSED)) {
+    // handle TASK_STATUS_CANCEL_DEFERRED here because we skip past the
+    // normal handling code
+
+    if (task_is(task, TASK_STATUS_CANCEL_DEFERRED)) {
+      cancel_task(ex, task);
     }
 
-    if ((task -> type) == TASK_TYPE_INTERVAL) {
-      // check if this task needs to be activated yet
+    return true;
+  }
+
+  // batched tasks take everything that's pending in one go, the rest take
+  // one activation per run
+  uint16_t run_activations = 1;
+  if (task_is(task, TASK_STATUS_BATCHED) && (task->type != TASK_TYPE_COROUTINE)) {
+    run_activations = task->pending_activations;
+  }
 
-      uint32_t interval_at = task->data_a;
-      uint32_t interval_rate = task->data_b;
+  if (CHECK_FULL(
+    (run_activations == 0) || (task->pending_activations < run_activations)
+  )) {
+    hal_panic("executor_tick_loop: pending_activations would underflow");
+    return false;
+  }
 
-      if (current_time >= interval_at) {
-        // it needs to be activated!
+  // let the task see what it's being run for
+  ex->running_activations = run_activations;
+  ex->running_events = 0;
+  if (task->type == TASK_TYPE_EVENT) {
+    ex->running_events = (uint32_t) task->data_b;
+    task->data_b = 0;
+  }
 
-        // avoid a possible division by zero
-        if (interval_rate == 0) {
-          hal_panic("executor_tick_loop: encountered a task interval_rate of 0");
-          return TIMESTAMP_MAX;
-        }
+  // it's time for the moment we've been waiting for
+  // execute that task!
+  task_set(task, TASK_STATUS_RUNNING);
+  trace_add(ex, TRACE_RUN_START, task->id, ex->task_queue_size);
+  uint32_t run_start = stats_run_start(ex, task);
+  task->target(task->id);
+  // show whatever it drew
+  framebuffer_present();
+  stats_run_end(ex, task, run_start);
+  trace_add(ex, TRACE_RUN_END, task->id, 0);
+  task_unset(task, TASK_STATUS_RUNNING);
 
-        // handle "overdue" activations, ones that should've happened by now
-        // XXX: there's a potential overflow here...
-        uint16_t overdue_activations = (current_time - interval_at) / interval_rate;
+  ex->running_activations = 0;
+  ex->running_events = 0;
 
-        // activate the task
-        // 1 activation, and however many more if we're behind schedule
-        // XXX: and an overflow here too...
-        activate_task(task, 1 + overdue_activations);
+  // fan out anything it emitted, so the subscribers can run in this batch
+  dispatch_emitted_events(ex);
 
-        // bump the next time we should check it
-        // we only ever increment by multiples of interval_rate, to ensure that
-        // the "phase" of the timing stays correct
-        task->data_a += (1 + overdue_activations) * interval_rate;
-      }
+  // drop the activations it just handled
+  task->pending_activations -= run_activations;
+
+  // does it need to be cancelled now?
+  if (task_is(task, TASK_STATUS_CANCEL_DEFERRED)) {
+    cancel_task(ex, task);
+
+    return true;
+  }
+
+  // a coroutine that returned without yielding, sleeping or waiting is done
+  if (
+    (task->type == TASK_TYPE_COROUTINE) &&
+    (task->pending_activations == 0) &&
+    !task_is(task, TASK_STATUS_WAIT_TIMER) &&
+    !task_is(task, TASK_STATUS_WAIT_EVENT) &&
+    !task_is(task, TASK_STATUS_PAUSED)
+  ) {
+    cancel_task(ex, task);
+
+    return true;
+  }
+
+  // does it need to be re-queued? (activations > 0)
+  if (task->pending_activations > 0) {
+    if (!task_is(task, TASK_STATUS_ON_QUEUE)) {
+      task_queue_push(ex, task);
+      task_set(task, TASK_STATUS_ON_QUEUE);
     }
   }
 
-  // step 3: pick a task from the queue and execute it
+  return true;
+}
 
-  {
-    executor_task* task = task_queue_pop();
+/*
+ * Step 4 of a tick: calculate when the event loop should tick next.
+ */
+static uint64_t tick_next_wakeup(executor_instance* ex) {
+  // if we have stuff in the queue, the answer should be "right away"
+  if (ex->task_queue_size > 0) {
+    return 0;
+  }
 
-    if (task == NULL) goto done_executing;
+  // if not, the soonest timer is at the top of the heap
+  // paused tasks aren't in there, so they won't cause us to tick earlier
+  uint64_t soonest = TIMESTAMP_MAX;
 
-    // sanity check first
-    // !TASK_STATUS_ALIVE -> if you want to cancel a task on the queue, just
-    // add TASK_STATUS_DEFERRED_CANCEL and wait for it to work its way through
-    // !TASK_STATUS_ON_QUEUE -> this should never happen...
-    if (!task_is(task, TASK_STATUS_ALIVE | TASK_STATUS_ON_QUEUE)) {
-      hal_panic("executor_tick_loop: task from queue has invalid flags");
-      return TIMESTAMP_MAX;
-    }
+  executor_task* next_timer = timer_heap_peek(ex);
+  if (next_timer != NULL) {
+    soonest = next_timer->data_a;
+  }
 
-    // it's not on the queue anymore
-    task_unset(task, TASK_STATUS_ON_QUEUE);
+  // this will be TIMESTAMP_MAX if there are no timers
+  return soonest;
+}
 
-    // if this task is paused (but is still in the queue from a previous activation)
-    // ignore it
-    if (task_is(task, TASK_STATUS_PAUSED)) {
-      // handle TASK_STATUS_CANCEL_DEFERRED here because we jump past the
-      // normal handling code
+/*
+ * Run a tick of an executor instance. Takes in the current time in
+ * microseconds. Events are taken from the instance's event ring.
+ *
+ * Returns the time (in microseconds) that the executor should be ticked at
+ * next, assuming no events happen before then. Returns EXECUTOR_WAKE_NEVER if
+ * no timers require the event loop to be ticked. Returns EXECUTOR_WAKE_NOW if
+ * the tick loop should be invoked as soon as possible.
+ */
+uint64_t executor_instance_tick_loop_us(executor_instance* ex, uint64_t current_time) {
+  executor_instance* previous = executor_set_current(ex);
+  uint64_t next_wakeup = TIMESTAMP_MAX;
 
-      if (task_is(task, TASK_STATUS_CANCEL_DEFERRED)) {
-        cancel_task(task);
-      }
+  trace_add(ex, TRACE_TICK_START, 0, ex->task_queue_size);
+
+  if (!tick_activate_tasks(ex, current_time)) goto done;
+  if (!tick_run_queued_task(ex)) goto done;
+
+  next_wakeup = tick_next_wakeup(ex);
+
+done:
+  trace_add(ex, TRACE_TICK_END, 0, ex->task_queue_size);
+  executor_set_current(previous);
+  return next_wakeup;
+}
+
+/*
+ * Run a tick of an executor instance, then keep executing queued tasks until
+ * the queue is empty, `max_tasks` tasks have run, or the instance's clock
+ * reaches `deadline`. At least one task is run if any are queued. A
+ * `max_tasks` of 0 means no limit on the number of tasks.
+ *
+ * Returns the same thing as executor_instance_tick_loop_us.
+ */
+uint64_t executor_instance_tick_until_us(
+  executor_instance* ex,
+  uint64_t current_time,
+  uint16_t max_tasks,
+  uint64_t deadline
+) {
+  executor_instance* previous = executor_set_current(ex);
+  uint64_t next_wakeup = TIMESTAMP_MAX;
+
+  trace_add(ex, TRACE_TICK_START, 0, ex->task_queue_size);
+
+  if (!tick_activate_tasks(ex, current_time)) goto done;
+
+  uint16_t tasks_run = 0;
+
+  while (ex->task_queue_size > 0) {
+    if (!tick_run_queued_task(ex)) goto done;
+    tasks_run++;
+
+    if ((max_tasks != 0) && (tasks_run >= max_tasks)) break;
+    if (executor_instance_micros(ex) >= deadline) break;
+  }
+
+  next_wakeup = tick_next_wakeup(ex);
+
+done:
+  trace_add(ex, TRACE_TICK_END, 0, ex->task_queue_size);
+  executor_set_current(previous);
+  return next_wakeup;
+}
+
+/*
+ * Millisecond wrapper around executor_instance_tick_loop_us. The timestamps
+ * are allowed to wrap around.
+ */
+uint32_t executor_instance_tick_loop(executor_instance* ex, uint32_t current_time) {
+  uint64_t current_time_us;
+  if (!unwrap_millis(ex, current_time, &current_time_us)) {
+    hal_panic("executor_tick_loop: time went backwards!");
+    return TIMESTAMP_MAX_MS;
+  }
+
+  return wrap_millis(ex, executor_instance_tick_loop_us(ex, current_time_us));
+}
+
+/*
+ * Millisecond wrapper around executor_instance_tick_until_us. The timestamps
+ * are allowed to wrap around.
+ */
+uint32_t executor_instance_tick_until(
+  executor_instance* ex,
+  uint32_t current_time,
+  uint16_t max_tasks,
+  uint32_t deadline
+) {
+  uint64_t current_time_us;
+  if (!unwrap_millis(ex, current_time, &current_time_us)) {
+    hal_panic("executor_tick_loop: time went backwards!");
+    return TIMESTAMP_MAX_MS;
+  }
+
+  uint64_t deadline_us = current_time_us + (uint64_t) (deadline - current_time) * 1000;
+
+  return wrap_millis(ex, executor_instance_tick_until_us(
+    ex,
+    current_time_us,
+    max_tasks,
+    deadline_us
+  ));
+}
+
+// the original platform api, bound to the default instance
+
+uint64_t executor_tick_loop_us(uint64_t current_time) {
+  return executor_instance_tick_loop_us(&default_executor, current_time);
+}
 
-      goto done_executing;
+uint64_t executor_tick_until_us(
+  uint64_t current_time,
+  uint16_t max_tasks,
+  uint64_t deadline
+) {
+  return executor_instance_tick_until_us(
+    &default_executor,
+    current_time,
+    max_tasks,
+    deadline
+  );
+}
+
+uint32_t executor_tick_loop(uint32_t current_time) {
+  return executor_instance_tick_loop(&default_executor, current_time);
+}
+
+uint32_t executor_tick_until(
+  uint32_t current_time,
+  uint16_t max_tasks,
+  uint32_t deadline
+) {
+  return executor_instance_tick_until(
+    &default_executor,
+    current_time,
+    max_tasks,
+    deadline
+  );
+}
+
+/*
+ * =================
+ * === SNAPSHOTS ===
+ * =================
+ */
+
+// a snapshot of an instance only holds what can't be worked out from the rest:
+// the live tasks, the order of the queue and of the free slot stack, and the
+// emitted events that haven't been dispatched. the timer heap and subscriber
+// bitmaps are rebuilt from the tasks on restore, and the stats start over.
+// pointers into an instance mean nothing in another one, so tasks are stored
+// with their slot index, and the queue and free stack as lists of slots.
+// events still in the event ring belong to the platform, and are left alone.
+
+// if a task is one of the timers that belong in the timer heap
+static bool task_is_timer(executor_task* task) {
+  return (
+    (task->type == TASK_TYPE_TIMEOUT) ||
+    (task->type == TASK_TYPE_INTERVAL) ||
+    task_is(task, TASK_STATUS_WAIT_TIMER)
+  );
+}
+
+/*
+ * Write the state of `ex` to a snapshot. Returns false if it's in the middle of
+ * running a task, and can't be saved.
+ */
+bool executor_instance_snapshot(executor_instance* ex, snapshot_writer* writer) {
+  if (ex->running_activations != 0) return false;
+
+  // the build has to match for the tasks to make sense
+  uint16_t num_tasks = NUM_TASKS;
+  uint16_t queue_size = QUEUE_SIZE;
+  uint8_t num_events = NUM_EVENTS;
+  uint8_t task_size = sizeof(executor_task);
+  snapshot_write(writer, &num_tasks, sizeof(num_tasks));
+  snapshot_write(writer, &queue_size, sizeof(queue_size));
+  snapshot_write(writer, &num_events, sizeof(num_events));
+  snapshot_write(writer, &task_size, sizeof(task_size));
+
+  // timers are restored relative to this
+  uint64_t now = executor_instance_micros(ex);
+  snapshot_write(writer, &now, sizeof(now));
+
+  snapshot_write(writer, &ex->task_id_nonce, sizeof(ex->task_id_nonce));
+  snapshot_write(writer, &ex->default_group, sizeof(ex->default_group));
+  snapshot_write(writer, &ex->emitted_events, sizeof(ex->emitted_events));
+  snapshot_write(writer, ex->emitted_event_counts, sizeof(ex->emitted_event_counts));
+
+  slot_index live_count = NUM_TASKS - ex->free_slot_count;
+  snapshot_write(writer, &live_count, sizeof(live_count));
+
+  for (slot_index i=0; i<NUM_TASKS; i++) {
+    executor_task* task = &ex->tasks[i];
+    if (!task_is(task, TASK_STATUS_ALIVE)) continue;
+
+    snapshot_write(writer, &i, sizeof(i));
+    snapshot_write(writer, task, sizeof(*task));
+    snapshot_write(writer, &ex->slot_groups[i], sizeof(ex->slot_groups[i]));
+  }
+
+  // every ring of the queue, from its head
+  for (uint8_t level=0; level<NUM_PRIORITIES; level++) {
+    uint16_t size = ex->task_queue_level_size[level];
+    snapshot_write(writer, &size, sizeof(size));
+
+    for (uint16_t i=0; i<size; i++) {
+      uint16_t index = (ex->task_queue_level_head[level] + i) % QUEUE_SIZE;
+      slot_index task_slot = TASK_ID_SLOT(ex->task_queue[level][index]->id);
+      snapshot_write(writer, &task_slot, sizeof(task_slot));
     }
+  }
+
+  snapshot_write(writer, &ex->free_slot_count, sizeof(ex->free_slot_count));
+  snapshot_write(
+    writer,
+    ex->free_slots,
+    ex->free_slot_count * sizeof(ex->free_slots[0])
+  );
 
-    // it's time for the moment we've been waiting for
-    // execute that task!
-    task_set(task, TASK_STATUS_RUNNING);
-    task->target(task->id);
-    task_unset(task, TASK_STATUS_RUNNING);
+  return true;
+}
 
-    // drop the activations by 1
-    if (task->pending_activations == 0) {
-      hal_panic("executor_tick_loop: pending_activations would underflow");
-      return TIMESTAMP_MAX;
+// read a slot index, and mark it in `seen`. returns false if it's out of
+// bounds or was already seen.
+static bool restore_read_slot(
+  snapshot_reader* reader,
+  uint32_t seen[TASK_BITMAP_WORDS],
+  slot_index* out_slot
+) {
+  snapshot_read(reader, out_slot, sizeof(*out_slot));
+
+  if (*out_slot >= NUM_TASKS) return false;
+
+  uint32_t bit = (1UL << (*out_slot % 32));
+  if (seen[*out_slot / 32] & bit) return false;
+  seen[*out_slot / 32] |= bit;
+
+  return true;
+}
+
+// go through a snapshot, either only checking that it's valid (`apply` is
+// false), or putting its state into `ex`. returns false if it's invalid.
+static bool restore_pass(
+  executor_instance* ex,
+  snapshot_reader* reader,
+  bool apply
+) {
+  uint16_t num_tasks, queue_size;
+  uint8_t num_events, task_size;
+  snapshot_read(reader, &num_tasks, sizeof(num_tasks));
+  snapshot_read(reader, &queue_size, sizeof(queue_size));
+  snapshot_read(reader, &num_events, sizeof(num_events));
+  snapshot_read(reader, &task_size, sizeof(task_size));
+
+  if (
+    (num_tasks != NUM_TASKS) ||
+    (queue_size != QUEUE_SIZE) ||
+    (num_events != NUM_EVENTS) ||
+    (task_size != sizeof(executor_task))
+  ) {
+    return false;
+  }
+
+  // every timer moves by however long it's been since the snapshot was taken
+  uint64_t saved_at;
+  snapshot_read(reader, &saved_at, sizeof(saved_at));
+  uint64_t now = executor_instance_micros(ex);
+  uint64_t time_shift = now - saved_at;
+
+  uint32_t task_id_nonce, emitted_events;
+  task_group default_group;
+  uint8_t emitted_event_counts[NUM_EVENTS];
+  snapshot_read(reader, &task_id_nonce, sizeof(task_id_nonce));
+  snapshot_read(reader, &default_group, sizeof(default_group));
+  snapshot_read(reader, &emitted_events, sizeof(emitted_events));
+  snapshot_read(reader, emitted_event_counts, sizeof(emitted_event_counts));
+
+  if (default_group >= TASK_GROUP_COUNT) return false;
+
+  if (apply) {
+    ex->task_id_nonce = task_id_nonce;
+    ex->default_group = default_group;
+    ex->emitted_events = emitted_events;
+    memcpy(ex->emitted_event_counts, emitted_event_counts, sizeof(emitted_event_counts));
+
+    memset(&ex->tasks, 0, sizeof(ex->tasks));
+    memset(&ex->slot_groups, 0, sizeof(ex->slot_groups));
+    for (slot_index i=0; i<NUM_TASKS; i++) stats_reset(ex, i);
+  }
+
+  // the slots that are live, then also the ones that are free
+  uint32_t seen[TASK_BITMAP_WORDS];
+  memset(seen, 0, sizeof(seen));
+
+  slot_index live_count;
+  snapshot_read(reader, &live_count, sizeof(live_count));
+  if (live_count > NUM_TASKS) return false;
+
+  for (slot_index i=0; i<live_count; i++) {
+    slot_index task_slot;
+    executor_task task;
+    task_group group;
+    if (!restore_read_slot(reader, seen, &task_slot)) return false;
+    snapshot_read(reader, &task, sizeof(task));
+    snapshot_read(reader, &group, sizeof(group));
+
+    if (
+      !task_is(&task, TASK_STATUS_ALIVE) ||
+      task_is(&task, TASK_STATUS_RUNNING) ||
+      (TASK_ID_SLOT(task.id) != task_slot) ||
+      (task.type > TASK_TYPE_COROUTINE) ||
+      (task.priority >= NUM_PRIORITIES) ||
+      ((task.type == TASK_TYPE_INTERVAL) && (task.data_b == 0)) ||
+      (group >= TASK_GROUP_COUNT)
+    ) {
+      return false;
     }
 
-    task->pending_activations--;
+    if (!apply) continue;
 
-    // does it need to be cancelled now?
-    if (task_is(task, TASK_STATUS_CANCEL_DEFERRED)) {
-      cancel_task(task);
+    task.timer_index = TIMER_HEAP_NONE;
+    if (task_is_timer(&task)) task.data_a += time_shift;
+
+    ex->tasks[task_slot] = task;
+    ex->slot_groups[task_slot] = group;
+  }
+
+  uint32_t queued[TASK_BITMAP_WORDS];
+  memset(queued, 0, sizeof(queued));
 
-      goto done_executing;
+  if (apply) {
+    memset(&ex->task_queue_level_head, 0, sizeof(ex->task_queue_level_head));
+    ex->task_queue_levels = 0;
+    ex->task_queue_size = 0;
+  }
+
+  for (uint8_t level=0; level<NUM_PRIORITIES; level++) {
+    uint16_t size;
+    snapshot_read(reader, &size, sizeof(size));
+    if (size > QUEUE_SIZE) return false;
+
+    for (uint16_t i=0; i<size; i++) {
+      // it has to be one of the live tasks, and only be on the queue once
+      slot_index task_slot;
+      if (!restore_read_slot(reader, queued, &task_slot)) return false;
+      if (!(seen[task_slot / 32] & (1UL << (task_slot % 32)))) return false;
+
+      if (apply) ex->task_queue[level][i] = &ex->tasks[task_slot];
     }
 
-    // does it need to be re-queued? (activations > 0)
-    if (task->pending_activations > 0) {
-      if (!task_is(task, TASK_STATUS_ON_QUEUE)) {
-        task_queue_push(task);
-        task_set(task, TASK_STATUS_ON_QUEUE);
-      }
+    if (apply) {
+      ex->task_queue_level_size[level] = size;
+      ex->task_queue_size += size;
+      if (size > 0) ex->task_queue_levels |= (1 << level);
     }
   }
 
-done_executing:
+  slot_index free_slot_count;
+  snapshot_read(reader, &free_slot_count, sizeof(free_slot_count));
+  if ((live_count + free_slot_count) != NUM_TASKS) return false;
 
-  // step 4: calculate when the event loop should tick next
+  for (slot_index i=0; i<free_slot_count; i++) {
+    slot_index task_slot;
+    if (!restore_read_slot(reader, seen, &task_slot)) return false;
 
-  // if we have stuff in the queue, the answer should be "right away"
-  if (task_queue_size > 0) {
-    return 0;
+    if (apply) ex->free_slots[i] = task_slot;
   }
 
-  // if not, go down the list of all the tasks and see which one is earliest
-  uint32_t soonest = TIMESTAMP_MAX;
+  if (!reader->ok) return false;
 
-  for (uint8_t i=0; i<NUM_TASKS; i++) {
-    executor_task* task = &tasks[i];
-    if (!task_is(task, TASK_STATUS_ALIVE)) continue;
+  if (apply) {
+    ex->free_slot_count = free_slot_count;
 
-    // only interval and timeout tasks change our next tick time
-    if (!(
-      (task->type == TASK_TYPE_INTERVAL) ||
-      (task->type == TASK_TYPE_TIMEOUT)
-    )) continue;
+    // rebuild everything that's derived from the tasks
+    memset(&ex->event_subscribers, 0, sizeof(ex->event_subscribers));
+    ex->timer_heap_size = 0;
 
-    // paused tasks shouldn't cause us to tick earlier
-    if (task_is(task, TASK_STATUS_PAUSED)) continue;
+    for (slot_index i=0; i<NUM_TASKS; i++) {
+      executor_task* task = &ex->tasks[i];
+      if (!task_is(task, TASK_STATUS_ALIVE)) continue;
 
-    uint32_t task_next_activation = task->data_a;
+      if (
+        (task->type == TASK_TYPE_EVENT) ||
+        task_is(task, TASK_STATUS_WAIT_EVENT)
+      ) {
+        event_subscribers_update(ex, i, task->data_a, true);
+      }
 
-    // bump down soonest to the soonest next activation
-    if (task_next_activation < soonest) {
-      soonest = task_next_activation;
+      if (
+        task_is_timer(task) &&
+        !task_is(task, TASK_STATUS_PAUSED) &&
+        !task_is(task, TASK_STATUS_CANCEL_DEFERRED)
+      ) {
+        timer_heap_push(ex, task);
+      }
     }
+
+    ex->last_tick_timestamp = now;
+    ex->last_tick_hal_micros = hal_micros();
   }
 
-  // this will be TIMESTAMP_MAX (0xFFFFFFFF) if nothing bumped it down
-  return soonest;
+  return true;
+}
+
+/*
+ * Put `ex` back into the state saved in a snapshot. Returns false, and leaves
+ * `ex` untouched, if the snapshot is invalid or from a different build.
+ */
+bool executor_instance_restore(executor_instance* ex, snapshot_reader* reader) {
+  if (ex->running_activations != 0) return false;
+
+  // check all of it before touching anything
+  snapshot_reader check = *reader;
+  if (!restore_pass(ex, &check, false)) {
+    reader->ok = false;
+    return false;
+  }
+
+  restore_pass(ex, reader, true);
+
+  return true;
 }
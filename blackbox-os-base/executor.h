@@ -15,6 +15,14 @@ typedef uint32_t time_stamp;
  * A time duration, measured in ms.
  */
 typedef uint32_t time_duration;
+/*
+ * A timestamp, measured in microseconds since system start.
+ */
+typedef uint64_t time_stamp_us;
+/*
+ * A time duration, measured in microseconds.
+ */
+typedef uint32_t time_duration_us;
 /*
  * A unique identifier for a task.
  */
@@ -23,5 +31,74 @@ typedef uint32_t task_handle;
  * The function to run when a task is executed.
  */
 typedef void (*task_target)(task_handle self);
+/*
+ * How urgently a task should run once it's activated. Activated tasks always
+ * run before any activated task of a lower priority.
+ */
+typedef enum {
+  // for reacting to input. event tasks start out at this priority.
+  TASK_PRIORITY_HIGH = 0,
+  // for regular game logic. timeout and interval tasks start out at this
+  // priority.
+  TASK_PRIORITY_NORMAL = 1,
+  // for background work. only runs when nothing else is waiting to run.
+  TASK_PRIORITY_IDLE = 2,
+} task_priority;
+
+/*
+ * What an interval task does when the executor falls behind and it misses
+ * activations.
+ */
+typedef enum {
+  // run once for every missed activation. good for counters and clocks.
+  TASK_CATCH_UP_ALL = 0,
+  // run once, no matter how many activations were missed. good for drawing
+  // frames.
+  TASK_CATCH_UP_COALESCE = 1,
+  // if a whole interval was missed, don't run at all until the next one.
+  TASK_CATCH_UP_SKIP = 2,
+} task_catch_up;
+
+/*
+ * A tag for a set of tasks that get cancelled, paused or unpaused together
+ * (ex: everything that belongs to one scene of a game). Groups are numbered
+ * 1-31, and tasks start out in TASK_GROUP_NONE.
+ */
+typedef uint8_t task_group;
+
+// the group of tasks that don't belong to any group
+// group operations never affect these
+#define TASK_GROUP_NONE 0
+
+// number of task groups, including TASK_GROUP_NONE
+#define TASK_GROUP_COUNT 32
+
+/*
+ * A bitfield of task groups (bit n = group n), for acting on several groups at
+ * once.
+ */
+typedef uint32_t task_group_mask;
+
+// get the mask for a single task group
+#define TASK_GROUP_MASK(group) (1UL << (group))
+
+/*
+ * Runtime statistics for a task. Only collected if the executor was built with
+ * EXECUTOR_ENABLE_STATS. Times are measured in microseconds.
+ */
+typedef struct {
+  // number of times the task has run
+  uint32_t run_count;
+  // total time spent running the task
+  uint64_t total_run_time;
+  // longest single run of the task
+  uint32_t max_run_time;
+  // total time the task spent waiting on the queue before running
+  uint64_t total_latency;
+  // longest time the task spent waiting on the queue before running
+  uint32_t max_latency;
+  // activations thrown away because the task had too many pending already
+  uint32_t dropped_activations;
+} task_stats;
 
 #endif
@@ -0,0 +1,217 @@
+/*
+ * executor_config.h: Compile-time sizing for the executor
+ *
+ * Everything here can be overridden from the compiler command line
+ * (ex: -DEXECUTOR_NUM_TASKS=128), otherwise a per-platform default is used.
+ */
+
+#ifndef EXECUTOR_CONFIG_H
+#define EXECUTOR_CONFIG_H
+
+// levels for EXECUTOR_CHECK_LEVEL, these need to exist before the defaults
+#define EXECUTOR_CHECKS_NONE 0
+#define EXECUTOR_CHECKS_CHEAP 1
+#define EXECUTOR_CHECKS_FULL 2
+
+/*
+ * =========================
+ * === PLATFORM DEFAULTS ===
+ * =========================
+ */
+
+#if defined(__EMSCRIPTEN__)
+// the editor has memory to spare, let big games go wild
+#define EXECUTOR_DEFAULT_NUM_TASKS 512
+// every plat_tick is a round trip through js and a setTimeout, so drain as
+// much as we can, but give the worker a chance to see button messages
+#define EXECUTOR_DEFAULT_BATCH_BUDGET_MS 8
+// people are writing and debugging games here, so catch everything we can
+#define EXECUTOR_DEFAULT_CHECK_LEVEL EXECUTOR_CHECKS_FULL
+#define EXECUTOR_DEFAULT_ARENA_SIZE (256UL * 1024)
+#elif defined(ARDUINO)
+// the rp2040 has 264kb of ram, but most of it belongs to the user
+#define EXECUTOR_DEFAULT_NUM_TASKS 64
+// button events are only picked up between batches, keep them short
+#define EXECUTOR_DEFAULT_BATCH_BUDGET_MS 2
+// games get here after running in the editor, and the full checks are a real
+// cost on a cortex-m0+
+#define EXECUTOR_DEFAULT_CHECK_LEVEL EXECUTOR_CHECKS_CHEAP
+// leave most of the ram to games that just use globals
+#define EXECUTOR_DEFAULT_ARENA_SIZE (32UL * 1024)
+#else
+// native builds (tests, batch runs on a desktop)
+#define EXECUTOR_DEFAULT_NUM_TASKS 512
+#define EXECUTOR_DEFAULT_BATCH_BUDGET_MS 8
+#define EXECUTOR_DEFAULT_CHECK_LEVEL EXECUTOR_CHECKS_FULL
+#define EXECUTOR_DEFAULT_ARENA_SIZE (256UL * 1024)
+#endif
+
+/*
+ * ===============
+ * === OPTIONS ===
+ * ===============
+ */
+
+// maximum number of tasks that can exist at once
+// each task takes about 55 bytes of global memory on the rp2040 (32 bit
+// pointers, 8 byte aligned uint64_t): the 32 byte executor_task, a 4 byte
+// pointer in each of the 3 priority rings of the queue and in the timer heap,
+// a 2 byte free list entry, a 1 byte group, and a bit per event in the
+// subscriber bitmaps (4 bytes). EXECUTOR_ENABLE_STATS adds another 44.
+// on a 64-bit host (ex: native tests), the struct is 40 bytes and each task
+// takes about 80.
+#ifndef EXECUTOR_NUM_TASKS
+#define EXECUTOR_NUM_TASKS EXECUTOR_DEFAULT_NUM_TASKS
+#endif
+
+// number of slots in the task queue
+// a task is only ever on the queue once, so this can't be below NUM_TASKS
+#ifndef EXECUTOR_QUEUE_SIZE
+#define EXECUTOR_QUEUE_SIZE EXECUTOR_NUM_TASKS
+#endif
+
+// number of distinct events the system can handle
+// this is limited to 32 as each one occupies a bit in an event_mask
+#ifndef EXECUTOR_NUM_EVENTS
+#define EXECUTOR_NUM_EVENTS 32
+#endif
+
+// how long the platform lets executor_tick_until drain the queue for, in ms
+#ifndef EXECUTOR_BATCH_BUDGET_MS
+#define EXECUTOR_BATCH_BUDGET_MS EXECUTOR_DEFAULT_BATCH_BUDGET_MS
+#endif
+
+// most tasks the platform lets executor_tick_until run per call (0 = no limit)
+#ifndef EXECUTOR_BATCH_MAX_TASKS
+#define EXECUTOR_BATCH_MAX_TASKS 0
+#endif
+
+// number of events that can be waiting in the event ring (see event_ring.h)
+// between ticks before new ones get dropped. must be a power of 2.
+// each one takes 8 bytes.
+#ifndef EXECUTOR_EVENT_RING_SIZE
+#define EXECUTOR_EVENT_RING_SIZE 64
+#endif
+
+// set to 1 to collect per-task runtime statistics (run count, run time,
+// queue latency, dropped activations). costs two hal_micros() calls per task
+// run, so it's off unless you're profiling.
+#ifndef EXECUTOR_ENABLE_STATS
+#define EXECUTOR_ENABLE_STATS 0
+#endif
+
+// set to 1 to keep a trace of everything the executor does (ticks, task
+// activations and runs, events, matrix and tone calls) in a ring the platform
+// can drain, see trace.h. costs a hal_micros() call per record.
+#ifndef EXECUTOR_ENABLE_TRACE
+#define EXECUTOR_ENABLE_TRACE 0
+#endif
+
+// number of records the trace ring holds before the oldest get overwritten.
+// must be a power of 2. each one takes 12 bytes.
+#ifndef EXECUTOR_TRACE_SIZE
+#define EXECUTOR_TRACE_SIZE 1024
+#endif
+
+// how much the executor checks its own state, and panics if it's wrong
+// - EXECUTOR_CHECKS_FULL: everything, including a NULL check on every flag
+//   operation and checks on internal invariants that only a bug could break
+// - EXECUTOR_CHECKS_CHEAP: only the checks that stop a bad state from
+//   corrupting memory or crashing (ex: a full queue), and ones the platform can
+//   trip (ex: time going backwards)
+// - EXECUTOR_CHECKS_NONE: nothing. a bug becomes undefined behavior.
+// errors that the executor has to recover from anyways are always reported.
+// set from the command line (ex: -DEXECUTOR_CHECK_LEVEL=1), see build.sh and
+// server.js for the release builds
+#ifndef EXECUTOR_CHECK_LEVEL
+#define EXECUTOR_CHECK_LEVEL EXECUTOR_DEFAULT_CHECK_LEVEL
+#endif
+
+// bytes reserved for user programs to allocate from, with bb_arena_alloc and
+// pools (see arena.h). it's a static array, so it's counted in the build's
+// memory use whether or not the program allocates anything.
+#ifndef EXECUTOR_ARENA_SIZE
+#define EXECUTOR_ARENA_SIZE EXECUTOR_DEFAULT_ARENA_SIZE
+#endif
+
+// number of low bits of a task handle used for the task's slot index
+// the rest of the bits are the nonce (see the TASK IDS section of executor.c)
+#ifndef EXECUTOR_TASK_INDEX_BITS
+#if EXECUTOR_NUM_TASKS <= 256
+#define EXECUTOR_TASK_INDEX_BITS 8
+#else
+#define EXECUTOR_TASK_INDEX_BITS 12
+#endif
+#endif
+
+// storage class of the "current executor" pointer that the user api acts on
+// the wasm build and the rp2040 only ever tick from one thread, so a plain
+// global is fine there. native builds may tick one instance per thread.
+#ifndef EXECUTOR_THREAD_LOCAL
+#if defined(__EMSCRIPTEN__) || defined(ARDUINO)
+#define EXECUTOR_THREAD_LOCAL
+#else
+#define EXECUTOR_THREAD_LOCAL _Thread_local
+#endif
+#endif
+
+/*
+ * ==============
+ * === CHECKS ===
+ * ==============
+ */
+
+#if EXECUTOR_NUM_TASKS < 1
+#error "EXECUTOR_NUM_TASKS must be at least 1"
+#endif
+
+// slot indices are stored as uint16_t, and 0xFFFF is reserved as a marker
+#if EXECUTOR_NUM_TASKS > 65535
+#error "EXECUTOR_NUM_TASKS can be at most 65535"
+#endif
+
+#if EXECUTOR_NUM_TASKS > (1UL << EXECUTOR_TASK_INDEX_BITS)
+#error "EXECUTOR_TASK_INDEX_BITS is too small to address every task slot"
+#endif
+
+// leave at least 8 bits of nonce, or the use-after-free protection is useless
+#if EXECUTOR_TASK_INDEX_BITS > 24
+#error "EXECUTOR_TASK_INDEX_BITS can be at most 24"
+#endif
+
+#if EXECUTOR_QUEUE_SIZE < EXECUTOR_NUM_TASKS
+#error "EXECUTOR_QUEUE_SIZE must be at least EXECUTOR_NUM_TASKS"
+#endif
+
+#if (EXECUTOR_EVENT_RING_SIZE & (EXECUTOR_EVENT_RING_SIZE - 1)) != 0
+#error "EXECUTOR_EVENT_RING_SIZE must be a power of 2"
+#endif
+
+// the ring's positions are uint16_t, and have to be able to tell full from empty
+#if (EXECUTOR_EVENT_RING_SIZE < 1) || (EXECUTOR_EVENT_RING_SIZE > 32768)
+#error "EXECUTOR_EVENT_RING_SIZE must be between 1 and 32768"
+#endif
+
+#if (EXECUTOR_TRACE_SIZE & (EXECUTOR_TRACE_SIZE - 1)) != 0
+#error "EXECUTOR_TRACE_SIZE must be a power of 2"
+#endif
+
+// the trace ring's positions and count are uint16_t
+#if (EXECUTOR_TRACE_SIZE < 1) || (EXECUTOR_TRACE_SIZE > 32768)
+#error "EXECUTOR_TRACE_SIZE must be between 1 and 32768"
+#endif
+
+#if (EXECUTOR_CHECK_LEVEL < EXECUTOR_CHECKS_NONE) || (EXECUTOR_CHECK_LEVEL > EXECUTOR_CHECKS_FULL)
+#error "EXECUTOR_CHECK_LEVEL must be 0 (none), 1 (cheap) or 2 (full)"
+#endif
+
+// snapshots store the arena's size as a uint32_t
+#if (EXECUTOR_ARENA_SIZE < 8) || (EXECUTOR_ARENA_SIZE > 0xFFFFFFFFUL)
+#error "EXECUTOR_ARENA_SIZE must be between 8 and 4294967295"
+#endif
+
+#if (EXECUTOR_NUM_EVENTS < 1) || (EXECUTOR_NUM_EVENTS > 32)
+#error "EXECUTOR_NUM_EVENTS must be between 1 and 32"
+#endif
+
+#endif
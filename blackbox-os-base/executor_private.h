@@ -5,25 +5,346 @@
 #ifndef EXECUTOR_PRIVATE_H
 #define EXECUTOR_PRIVATE_H
 
+#include <stdbool.h>
 #include "executor.h"
+#include "executor_config.h"
+#include "event_ring.h"
+#include "snapshot.h"
+#include "trace.h"
+
+/*
+ * =============
+ * === TYPES ===
+ * =============
+ */
+
+// number of task priority levels (see task_priority in executor.h)
+#define EXECUTOR_NUM_PRIORITIES 3
+
+// number of 32-bit words needed to hold one bit per task slot
+#define EXECUTOR_TASK_BITMAP_WORDS ((EXECUTOR_NUM_TASKS + 31) / 32)
+
+// an index into the tasks array (or any other array sized by NUM_TASKS)
+typedef uint16_t slot_index;
+
+typedef enum {
+  // task is activated by an external event
+  // data_a = bitfield of events
+  // data_b = bitfield of the events that fired since it last ran
+  TASK_TYPE_EVENT = 0,
+  // task is activated by a one-off timeout, and then cancelled after
+  // data_a = timestamp that the task activates at (us)
+  TASK_TYPE_TIMEOUT = 1,
+  // task is activated by a repeating interval
+  // data_a = next time to check for activation (us)
+  // data_b = interval for activation (us)
+  TASK_TYPE_INTERVAL = 2,
+  // task is a coroutine, activated when it resumes (see the COROUTINES
+  // section of executor.c)
+  // data_a = timestamp it's sleeping until (us), or bitfield of events it's
+  // waiting for, depending on its status flags
+  // data_b = resume point
+  TASK_TYPE_COROUTINE = 3,
+} task_type;
+
+// this should pack down to 32 bytes (tested on clang armv7-a)
+typedef struct {
+  // the function to call to execute this task
+  task_target target;
+  // the full id (nonce in the high bits, slot index in the low bits)
+  uint32_t id;
+  // the number of pending activations this task has
+  uint16_t pending_activations;
+  // the status flags of this task, as a bitfield
+  // NOTE: uint8_t to save size on struct alignment
+  uint8_t status_flags;
+
+  // the type of this task
+  // NOTE: uint8_t to save size on struct alignment
+  uint8_t type;
+  // which ring of the task queue this task goes on (a task_priority)
+  // NOTE: uint8_t to save size on struct alignment
+  uint8_t priority;
+  // what an interval task does about missed activations (a task_catch_up)
+  // NOTE: uint8_t to save size on struct alignment
+  uint8_t catch_up;
+  // position of this task in the timer heap, or TIMER_HEAP_NONE if it isn't
+  // in there (see the TIMER HEAP section of executor.c)
+  slot_index timer_index;
+  // data for this task (type-dependent)
+  uint64_t data_a;
+  // data for this task (type-dependent)
+  uint64_t data_b;
+} executor_task;
+
+// all the state of one executor (one black box)
+// see the matching sections of executor.c for how each part is used
+typedef struct {
+  // all the tasks
+  executor_task tasks[EXECUTOR_NUM_TASKS];
+
+#if EXECUTOR_ENABLE_STATS
+  // stats for the task in each slot, reset when the slot is allocated
+  task_stats slot_stats[EXECUTOR_NUM_TASKS];
+  // hal_micros() when the task in each slot was last put on the queue
+  uint32_t slot_queued_at[EXECUTOR_NUM_TASKS];
+#endif
+
+#if EXECUTOR_ENABLE_TRACE
+  // what the executor has done since the platform last drained it
+  trace_ring trace;
+#endif
+
+  // ring buffers that represent the currently active task queue, per priority
+  executor_task* task_queue[EXECUTOR_NUM_PRIORITIES][EXECUTOR_QUEUE_SIZE];
+  // how many items are currently in each priority's ring
+  uint16_t task_queue_level_size[EXECUTOR_NUM_PRIORITIES];
+  // an index representing the head of each priority's ring
+  uint16_t task_queue_level_head[EXECUTOR_NUM_PRIORITIES];
+  // bitmap of the priority levels with something in them (bit n = priority n)
+  uint8_t task_queue_levels;
+  // how many items are currently in the task queue, across all priorities
+  uint16_t task_queue_size;
+
+  // min-heap of the active timer tasks, ordered by data_a
+  executor_task* timer_heap[EXECUTOR_NUM_TASKS];
+  // how many items are currently in the timer heap
+  slot_index timer_heap_size;
+
+  // events from the platform that haven't been dispatched yet
+  event_ring events;
+
+  // for every event, a bitmap of the task slots that are listening for it
+  uint32_t event_subscribers[EXECUTOR_NUM_EVENTS][EXECUTOR_TASK_BITMAP_WORDS];
+
+  // how many times each event has been emitted by user code, since they were
+  // last dispatched
+  uint8_t emitted_event_counts[EXECUTOR_NUM_EVENTS];
+  // bitmap of the events with a non-zero emitted count
+  uint32_t emitted_events;
+
+  // stack of task slots that aren't alive
+  slot_index free_slots[EXECUTOR_NUM_TASKS];
+  // how many slots are currently on the free stack
+  slot_index free_slot_count;
+
+  // the task_group of the task in each slot
+  // NOTE: kept out of executor_task, which has no room left in its 32 bytes
+  task_group slot_groups[EXECUTOR_NUM_TASKS];
+  // the group that new tasks are put in
+  task_group default_group;
+
+  // nonce for the next task id (see the TASK IDS section of executor.c)
+  uint32_t task_id_nonce;
+
+  // last time the event loop tick was called
+  uint64_t last_tick_timestamp;
+  // hal_micros() at the moment last_tick_timestamp was taken
+  uint32_t last_tick_hal_micros;
+
+  // the last 32-bit millisecond timestamp passed to executor_tick_loop, and the
+  // same moment on a 64-bit clock, used to unwrap the millisecond api's time
+  uint32_t last_tick_millis;
+  uint64_t last_tick_millis_64;
+
+  // what the running task is being run for (see task_activation_count and
+  // task_fired_events), 0 when no task is running
+  uint16_t running_activations;
+  uint32_t running_events;
+
+  // the matrix as this instance's tasks have drawn it, and the rows that
+  // changed since it was last presented (bit n = row n, see framebuffer.h)
+  uint8_t framebuffer_rows[8];
+  uint8_t framebuffer_dirty;
+
+  // free for the platform to use (ex: to find its own state from a task)
+  void* user_data;
+} executor_instance;
+
+/*
+ * =================
+ * === INSTANCES ===
+ * =================
+ */
+
+// the instance that the instance-less functions below act on
+extern executor_instance default_executor;
+
+/*
+ * Initialize an executor instance. This needs to be run before the instance is
+ * ticked. Any tasks it had are forgotten.
+ */
+void executor_instance_init(executor_instance* ex);
+
+/*
+ * Get the instance that the user api currently acts on. This is the instance
+ * being ticked, or the default instance outside of a tick.
+ */
+executor_instance* executor_current();
+
+/*
+ * Make the user api act on `ex`. Returns the previously current instance, so
+ * it can be restored. The tick functions do this automatically.
+ */
+executor_instance* executor_set_current(executor_instance* ex);
+
+/*
+ * Get the current time of an instance, in microseconds since it was started.
+ */
+uint64_t executor_instance_micros(executor_instance* ex);
+
+/*
+ * Record that an event happened, to be dispatched on the next tick of `ex`.
+ * This is safe to call from an interrupt handler while `ex` is being ticked,
+ * as long as only one context ever pushes events into a given instance.
+ * Returns false if the event ring was full, and the event was dropped.
+ */
+bool executor_instance_push_event(executor_instance* ex, uint8_t event_id);
+
+/*
+ * Run a tick of an instance. Same as executor_tick_loop_us, but on `ex`.
+ */
+uint64_t executor_instance_tick_loop_us(executor_instance* ex, uint64_t current_time);
+
+/*
+ * Run a batch on an instance. Same as executor_tick_until_us, but on `ex`.
+ */
+uint64_t executor_instance_tick_until_us(
+  executor_instance* ex,
+  uint64_t current_time,
+  uint16_t max_tasks,
+  uint64_t deadline
+);
+
+/*
+ * Millisecond wrapper around executor_instance_tick_loop_us.
+ */
+uint32_t executor_instance_tick_loop(executor_instance* ex, uint32_t current_time);
+
+/*
+ * Millisecond wrapper around executor_instance_tick_until_us.
+ */
+uint32_t executor_instance_tick_until(
+  executor_instance* ex,
+  uint32_t current_time,
+  uint16_t max_tasks,
+  uint32_t deadline
+);
+
+/*
+ * Write the state of `ex` to a snapshot (see snapshot.h). Returns false if a
+ * task is running, which means it can't be saved right now.
+ */
+bool executor_instance_snapshot(executor_instance* ex, snapshot_writer* writer);
+
+/*
+ * Put `ex` back into the state saved by executor_instance_snapshot, shifting
+ * its timers to the current time. Returns false, and leaves `ex` untouched, if
+ * the snapshot is invalid or from a different build.
+ */
+bool executor_instance_restore(executor_instance* ex, snapshot_reader* reader);
+
+/*
+ * Move up to `max_records` of the oldest trace records of `ex` into
+ * `out_records` (see trace.h). Returns how many were moved, which is always 0
+ * if the executor was built without EXECUTOR_ENABLE_TRACE.
+ */
+size_t executor_instance_trace_drain(
+  executor_instance* ex,
+  trace_record* out_records,
+  size_t max_records
+);
+
+/*
+ * Get the number of trace records of `ex` that were overwritten before they
+ * could be drained.
+ */
+uint32_t executor_instance_trace_dropped(executor_instance* ex);
+
+/*
+ * ====================
+ * === PLATFORM API ===
+ * ====================
+ */
+
+// these all act on the default instance
 
 /*
  * Initialize the executor. This needs to be run before the loop is ticked.
  */
 void executor_init();
 
+// executor_tick_loop_us return value: tick again as soon as possible
+#define EXECUTOR_WAKE_NOW 0ULL
+// executor_tick_loop_us return value: no timers need the loop to be ticked
+#define EXECUTOR_WAKE_NEVER 0xFFFFFFFFFFFFFFFFULL
+
+/*
+ * Get the current time, in microseconds since the executor was started.
+ */
+uint64_t executor_micros();
+
+/*
+ * Record that an event happened, to be dispatched on the next tick. Same as
+ * executor_instance_push_event, on the default instance.
+ */
+bool executor_push_event(uint8_t event_id);
+
+/*
+ * Drain the trace of the default instance. Same as
+ * executor_instance_trace_drain.
+ */
+size_t executor_trace_drain(trace_record* out_records, size_t max_records);
+
+/*
+ * Run a tick of the event loop. Takes in the current time in microseconds.
+ * Events are taken from the event ring, see executor_push_event.
+ *
+ * Returns the time (in microseconds) that the executor should be ticked at
+ * next, assuming no events happen before then. Returns EXECUTOR_WAKE_NEVER if
+ * no timers require the event loop to be ticked. Returns EXECUTOR_WAKE_NOW if
+ * the tick loop should be invoked as soon as possible.
+ */
+uint64_t executor_tick_loop_us(uint64_t current_time);
+
 /*
- * Run a tick of the event loop. Takes in the current timestamp, and an array
- * of the number of times events have occurred since the last tick.
- * 
+ * Run a tick of the event loop, then keep executing queued tasks until the
+ * queue is empty, `max_tasks` tasks have run, or executor_micros() reaches
+ * `deadline`. At least one task is run if any are queued. A `max_tasks` of 0
+ * means no limit on the number of tasks.
+ *
+ * Returns the same thing as executor_tick_loop_us.
+ */
+uint64_t executor_tick_until_us(
+  uint64_t current_time,
+  uint16_t max_tasks,
+  uint64_t deadline
+);
+
+/*
+ * Run a tick of the event loop. Takes in the current timestamp (ms).
+ *
  * Returns the timestamp that the executor should be ticked at next, assuming
  * no events happen before then. Returns 0xFFFFFFFF if no timers require the 
  * event loop to be ticked. Returns 0 if the tick loop should be invoked as
  * soon as possible.
+ *
+ * Millisecond wrapper around executor_tick_loop_us. The timestamps are allowed
+ * to wrap around.
+ */
+uint32_t executor_tick_loop(uint32_t current_time);
+
+/*
+ * Millisecond wrapper around executor_tick_until_us. The timestamps are
+ * allowed to wrap around.
  */
-uint32_t executor_tick_loop(uint32_t current_time, uint8_t* event_counts_in);
-// XXX: ^ event_counts_in lost its length... do we care?
-// should all of this be moved to a config.h of sorts (probably!)
+uint32_t executor_tick_until(
+  uint32_t current_time,
+  uint16_t max_tasks,
+  uint32_t deadline
+);
+
+// the user api, acting on executor_current()
 
 task_handle executor_api_task_create_event(
   task_target target,
@@ -31,15 +352,43 @@ task_handle executor_api_task_create_event(
 );
 task_handle executor_api_task_create_interval(
   task_target target,
-  uint32_t next_activate,
-  uint32_t interval
+  uint64_t next_activate,
+  uint64_t interval
 );
 task_handle executor_api_task_create_timeout(
   task_target target,
-  uint32_t activate_timestamp
+  uint64_t activate_timestamp
+);
+task_handle executor_api_task_create_coroutine(task_target target);
+uint32_t executor_api_task_coroutine_resume_point(task_handle handle);
+void executor_api_task_coroutine_yield(task_handle handle, uint32_t resume_point);
+void executor_api_task_coroutine_sleep(
+  task_handle handle,
+  uint32_t resume_point,
+  uint64_t wake_timestamp
+);
+void executor_api_task_coroutine_wait_event(
+  task_handle handle,
+  uint32_t resume_point,
+  uint32_t event_mask
 );
 void executor_api_task_cancel(task_handle handle);
+void executor_api_task_activate(task_handle handle);
+void executor_api_task_set_batched(task_handle handle, bool batched);
+uint16_t executor_api_task_activation_count();
+uint32_t executor_api_task_fired_events();
+void executor_api_emit_event(uint32_t event_mask);
 void executor_api_task_pause(task_handle handle);
 void executor_api_task_unpause(task_handle handle);
+void executor_api_task_set_group(task_handle handle, task_group group);
+task_group executor_api_task_set_default_group(task_group group);
+void executor_api_task_group_cancel(task_group_mask group_mask);
+void executor_api_task_group_pause(task_group_mask group_mask);
+void executor_api_task_group_unpause(task_group_mask group_mask);
+void executor_api_task_set_priority(task_handle handle, task_priority priority);
+void executor_api_task_set_catch_up(task_handle handle, task_catch_up catch_up);
+bool executor_api_task_get_stats(task_handle handle, task_stats* out_stats);
+void executor_api_debug_print_tasks();
+void executor_api_trace(trace_type type, uint16_t value);
 
 #endif
@@ -0,0 +1,79 @@
+/*
+ * framebuffer.c: The base's copy of the LED matrix
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "framebuffer.h"
+#include "executor_private.h"
+#include "hal.h"
+
+/*
+ * ===============
+ * === DRAWING ===
+ * ===============
+ */
+
+// the state lives in executor_instance.framebuffer_*
+
+uint8_t framebuffer_get_row(uint8_t y) {
+  return executor_current()->framebuffer_rows[y & 7];
+}
+
+void framebuffer_set_row(uint8_t y, uint8_t row) {
+  executor_instance* ex = executor_current();
+  y &= 7;
+
+  if (ex->framebuffer_rows[y] == row) return;
+
+  ex->framebuffer_rows[y] = row;
+  ex->framebuffer_dirty |= (1 << y);
+}
+
+void framebuffer_get(uint8_t out_rows[8]) {
+  executor_instance* ex = executor_current();
+
+  memcpy(out_rows, ex->framebuffer_rows, sizeof(ex->framebuffer_rows));
+}
+
+void framebuffer_set(const uint8_t rows[8]) {
+  executor_instance* ex = executor_current();
+
+  for (uint8_t y=0; y<8; y++) {
+    if (ex->framebuffer_rows[y] != rows[y]) {
+      ex->framebuffer_rows[y] = rows[y];
+      ex->framebuffer_dirty |= (1 << y);
+    }
+  }
+}
+
+/*
+ * ==================
+ * === PRESENTING ===
+ * ==================
+ */
+
+void framebuffer_present() {
+  executor_instance* ex = executor_current();
+
+  if (ex->framebuffer_dirty == 0) return;
+
+  // the hal's matrix belongs to the default instance
+  if (ex != &default_executor) {
+    ex->framebuffer_dirty = 0;
+    return;
+  }
+
+  hal_matrix_set_rows(ex->framebuffer_rows, ex->framebuffer_dirty);
+  ex->framebuffer_dirty = 0;
+
+#if EXECUTOR_ENABLE_TRACE
+  uint16_t lit = 0;
+  for (uint8_t y=0; y<8; y++) lit += __builtin_popcount(ex->framebuffer_rows[y]);
+  executor_api_trace(TRACE_HAL_MATRIX, lit);
+#endif
+}
+
+void framebuffer_invalidate() {
+  executor_current()->framebuffer_dirty = FRAMEBUFFER_ALL_ROWS;
+}
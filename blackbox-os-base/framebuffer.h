@@ -0,0 +1,61 @@
+/*
+ * framebuffer.h: The base's copy of the LED matrix
+ *
+ * Drawing doesn't go straight to the hal, which on the rp2040 pushes rows
+ * through the inter-core FIFO, and on wasm calls out to js. It goes into a
+ * shadow framebuffer instead, which remembers which rows changed (are dirty).
+ * Only those rows are sent to the hal, in one call, when the framebuffer is
+ * presented: after every task run (see executor.c), or whenever the program
+ * calls bb_matrix_present.
+ *
+ * The framebuffer is the real state of the matrix, so reading pixels never
+ * touches the hal either.
+ *
+ * Every executor instance has its own framebuffer, and these functions act on
+ * the current one (see executor_current), the same as the user api. There's
+ * only one real matrix, so only the default instance's framebuffer is sent to
+ * the hal. Instances ticked on other threads (ex: for batch testing) draw into
+ * their own, and never race with the default instance, or each other.
+ */
+
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <stdint.h>
+
+// every row, as a bitmask for framebuffer dirty masks
+#define FRAMEBUFFER_ALL_ROWS 0xFF
+
+/*
+ * Get row `y` (0-7, top to bottom), with the most significant bit on the left.
+ */
+uint8_t framebuffer_get_row(uint8_t y);
+
+/*
+ * Set row `y`. It's only marked dirty if it actually changed.
+ */
+void framebuffer_set_row(uint8_t y, uint8_t row);
+
+/*
+ * Copy every row into `out_rows`.
+ */
+void framebuffer_get(uint8_t out_rows[8]);
+
+/*
+ * Set every row, marking the ones that changed dirty.
+ */
+void framebuffer_set(const uint8_t rows[8]);
+
+/*
+ * Send the dirty rows to the hal. Does nothing if none are dirty, or if the
+ * current instance isn't the default one (its rows just stop being dirty).
+ */
+void framebuffer_present();
+
+/*
+ * Mark every row dirty, so the next present sends the whole framebuffer (ex:
+ * after something else wrote to the hal).
+ */
+void framebuffer_invalidate();
+
+#endif
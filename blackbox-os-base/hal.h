@@ -13,6 +13,12 @@
  */
 uint32_t hal_millis();
 
+/*
+ * Get the number of microseconds since the application has started. This wraps
+ * around roughly every 71 minutes.
+ */
+uint32_t hal_micros();
+
 /// LED Matrix
 
 /*
@@ -22,6 +28,13 @@ uint32_t hal_millis();
  */
 void hal_matrix_set_arr(uint8_t arr[8]);
 
+/*
+ * Set only some rows of the LED matrix: row n is taken from `arr` if bit n of
+ * `rows` is set, and left alone otherwise. The base draws into its own
+ * framebuffer (see framebuffer.h) and uses this to send the rows that changed.
+ */
+void hal_matrix_set_rows(uint8_t arr[8], uint8_t rows);
+
 /*
  * Copy the current state of the LED matrix to an array.
  */
@@ -0,0 +1,465 @@
+/*
+ * log_ring.c: Deferred logging
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "log_ring.h"
+#include "hal.h"
+
+/*
+ * ===============
+ * === DEFINES ===
+ * ===============
+ */
+
+// LOG_RING_SIZE is a power of 2, so this turns a position into an index
+#define LOG_RING_MASK (LOG_RING_SIZE - 1)
+
+// longest conversion spec that gets formatted (ex: "%-08.3lld")
+// longer ones are printed as "?", but still take their arguments
+#define MAX_SPEC_LENGTH 16
+
+/*
+ * =============
+ * === STATE ===
+ * =============
+ */
+
+// messages come from interrupt handlers as well as the main loop, so unlike
+// the event ring this has several producers. every access is done in a
+// critical section, which is short since it's just a copy.
+static log_entry entries[LOG_RING_SIZE];
+// position of the oldest message
+static uint16_t head = 0;
+// number of messages in the ring
+static uint16_t count = 0;
+// messages thrown away because the ring was full
+static uint32_t dropped = 0;
+// what `dropped` was the last time log_ring_flush reported it
+static uint32_t dropped_reported = 0;
+
+/*
+ * ====================
+ * === FORMAT SPECS ===
+ * ====================
+ */
+
+// both sides need to agree on how many bytes every argument takes, which
+// depends on the conversion spec it's for
+
+// the type an argument was passed as (after the default promotions)
+typedef enum {
+  // nothing, the spec is "%%" or something we don't understand
+  ARG_NONE = 0,
+  ARG_INT,
+  ARG_LONG,
+  ARG_LONG_LONG,
+  ARG_INTMAX,
+  ARG_SIZE,
+  ARG_PTRDIFF,
+  ARG_DOUBLE,
+  ARG_LONG_DOUBLE,
+  ARG_POINTER,
+  // a pointer for %n. it's taken, but never written through
+  ARG_IGNORED_POINTER,
+} arg_type;
+
+typedef struct {
+  // the whole spec, starting at the %
+  const char* start;
+  size_t length;
+  // number of '*' widths/precisions, each takes an int before the value
+  uint8_t stars;
+  arg_type type;
+} format_spec;
+
+static size_t arg_size(arg_type type) {
+  switch (type) {
+    case ARG_INT: return sizeof(int);
+    case ARG_LONG: return sizeof(long);
+    case ARG_LONG_LONG: return sizeof(long long);
+    case ARG_INTMAX: return sizeof(intmax_t);
+    case ARG_SIZE: return sizeof(size_t);
+    case ARG_PTRDIFF: return sizeof(ptrdiff_t);
+    case ARG_DOUBLE: return sizeof(double);
+    case ARG_LONG_DOUBLE: return sizeof(long double);
+    case ARG_POINTER: return sizeof(void*);
+    case ARG_IGNORED_POINTER: return sizeof(void*);
+    default: return 0;
+  }
+}
+
+/*
+ * Parse the conversion spec starting at `percent`. Returns a pointer to just
+ * past it.
+ */
+static const char* parse_spec(const char* percent, format_spec* spec) {
+  const char* p = percent + 1;
+
+  spec->start = percent;
+  spec->stars = 0;
+  spec->type = ARG_NONE;
+
+  // flags
+  while ((*p != '\0') && (strchr("-+ #0", *p) != NULL)) p++;
+
+  // width
+  if (*p == '*') {
+    spec->stars++;
+    p++;
+  } else {
+    while ((*p >= '0') && (*p <= '9')) p++;
+  }
+
+  // precision
+  if (*p == '.') {
+    p++;
+    if (*p == '*') {
+      spec->stars++;
+      p++;
+    } else {
+      while ((*p >= '0') && (*p <= '9')) p++;
+    }
+  }
+
+  // length modifier, as the integer type it picks
+  arg_type int_type = ARG_INT;
+  bool long_double = false;
+  switch (*p) {
+    case 'h':
+      // short and char are promoted to int anyways
+      p++;
+      if (*p == 'h') p++;
+      break;
+    case 'l':
+      p++;
+      int_type = ARG_LONG;
+      if (*p == 'l') {
+        p++;
+        int_type = ARG_LONG_LONG;
+      }
+      break;
+    case 'j': p++; int_type = ARG_INTMAX; break;
+    case 'z': p++; int_type = ARG_SIZE; break;
+    case 't': p++; int_type = ARG_PTRDIFF; break;
+    case 'L': p++; long_double = true; break;
+    default: break;
+  }
+
+  // conversion
+  char conversion = *p;
+  if (conversion != '\0') p++;
+
+  switch (conversion) {
+    case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+      spec->type = int_type;
+      break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+      spec->type = long_double ? ARG_LONG_DOUBLE : ARG_DOUBLE;
+      break;
+    case 's': case 'p':
+      spec->type = ARG_POINTER;
+      break;
+    case 'n':
+      spec->type = ARG_IGNORED_POINTER;
+      break;
+    default:
+      // "%%", or garbage. nothing is taken for these, so no stars either
+      spec->stars = 0;
+      break;
+  }
+
+  spec->length = (size_t) (p - percent);
+
+  return p;
+}
+
+/*
+ * ===============
+ * === WRITING ===
+ * ===============
+ */
+
+// copy an argument into the entry, unless an earlier one didn't fit
+static void pack_arg(
+  log_entry* entry,
+  bool* truncated,
+  const void* arg,
+  size_t size
+) {
+  if (*truncated || ((entry->arg_bytes + size) > LOG_RING_MAX_ARG_BYTES)) {
+    *truncated = true;
+    return;
+  }
+
+  memcpy(&entry->args[entry->arg_bytes], arg, size);
+  entry->arg_bytes += size;
+}
+
+bool log_ring_writev(const char* format, va_list args) {
+  log_entry entry;
+  entry.format = format;
+  entry.timestamp = hal_micros();
+  entry.arg_bytes = 0;
+
+  bool truncated = false;
+
+  // pull every argument out with the type its spec says it has
+  const char* p = format;
+  while ((p = strchr(p, '%')) != NULL) {
+    format_spec spec;
+    p = parse_spec(p, &spec);
+
+    for (uint8_t i=0; i<spec.stars; i++) {
+      int star = va_arg(args, int);
+      pack_arg(&entry, &truncated, &star, sizeof(star));
+    }
+
+    switch (spec.type) {
+      case ARG_INT: {
+        int value = va_arg(args, int);
+        pack_arg(&entry, &truncated, &value, sizeof(value));
+        break;
+      }
+      case ARG_LONG: {
+        long value = va_arg(args, long);
+        pack_arg(&entry, &truncated, &value, sizeof(value));
+        break;
+      }
+      case ARG_LONG_LONG: {
+        long long value = va_arg(args, long long);
+        pack_arg(&entry, &truncated, &value, sizeof(value));
+        break;
+      }
+      case ARG_INTMAX: {
+        intmax_t value = va_arg(args, intmax_t);
+        pack_arg(&entry, &truncated, &value, sizeof(value));
+        break;
+      }
+      case ARG_SIZE: {
+        size_t value = va_arg(args, size_t);
+        pack_arg(&entry, &truncated, &value, sizeof(value));
+        break;
+      }
+      case ARG_PTRDIFF: {
+        ptrdiff_t value = va_arg(args, ptrdiff_t);
+        pack_arg(&entry, &truncated, &value, sizeof(value));
+        break;
+      }
+      case ARG_DOUBLE: {
+        double value = va_arg(args, double);
+        pack_arg(&entry, &truncated, &value, sizeof(value));
+        break;
+      }
+      case ARG_LONG_DOUBLE: {
+        long double value = va_arg(args, long double);
+        pack_arg(&entry, &truncated, &value, sizeof(value));
+        break;
+      }
+      case ARG_POINTER:
+      case ARG_IGNORED_POINTER: {
+        void* value = va_arg(args, void*);
+        pack_arg(&entry, &truncated, &value, sizeof(value));
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  // only copy the part of the entry that's used
+  size_t entry_size = offsetof(log_entry, args) + entry.arg_bytes;
+  bool ok = true;
+
+  hal_critical_enter();
+  if (count == LOG_RING_SIZE) {
+    dropped++;
+    ok = false;
+  } else {
+    memcpy(&entries[(head + count) & LOG_RING_MASK], &entry, entry_size);
+    count++;
+  }
+  hal_critical_exit();
+
+  return ok;
+}
+
+bool log_ring_write(const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  bool ok = log_ring_writev(format, args);
+  va_end(args);
+
+  return ok;
+}
+
+/*
+ * ===============
+ * === READING ===
+ * ===============
+ */
+
+bool log_ring_pop(log_entry* out_entry) {
+  bool ok = false;
+
+  hal_critical_enter();
+  if (count > 0) {
+    log_entry* entry = &entries[head];
+    memcpy(out_entry, entry, offsetof(log_entry, args) + entry->arg_bytes);
+    head = (head + 1) & LOG_RING_MASK;
+    count--;
+    ok = true;
+  }
+  hal_critical_exit();
+
+  return ok;
+}
+
+uint32_t log_ring_dropped() {
+  return dropped;
+}
+
+/*
+ * ==================
+ * === FORMATTING ===
+ * ==================
+ */
+
+// appends to a string. `used` keeps counting past the end of the buffer, so
+// the whole length is known even if it didn't fit.
+typedef struct {
+  char* data;
+  size_t size;
+  size_t used;
+} text_writer;
+
+static void text_printf(text_writer* writer, const char* format, ...) {
+  // once something didn't fit, stop writing so the output is cut off cleanly
+  size_t left = 0;
+  if (writer->used < writer->size) left = writer->size - writer->used;
+
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(
+    (left > 0) ? (writer->data + writer->used) : NULL,
+    left,
+    format,
+    args
+  );
+  va_end(args);
+
+  if (length > 0) writer->used += (size_t) length;
+}
+
+// format one argument of type `type` with `spec_format`, passing the stars
+// first if there are any
+#define FORMAT_ARG(type) do { \
+    type value; \
+    memcpy(&value, arg, sizeof(value)); \
+    if (spec.stars == 0) text_printf(&writer, spec_format, value); \
+    if (spec.stars == 1) text_printf(&writer, spec_format, stars[0], value); \
+    if (spec.stars == 2) text_printf(&writer, spec_format, stars[0], stars[1], value); \
+  } while (0)
+
+size_t log_ring_format(const log_entry* entry, char* out, size_t out_size) {
+  text_writer writer = { .data = out, .size = out_size, .used = 0 };
+
+  // null-terminate, in case there's nothing to write
+  if (out_size > 0) out[0] = '\0';
+
+  const uint8_t* arg = entry->args;
+  size_t arg_bytes_left = entry->arg_bytes;
+
+  const char* p = entry->format;
+  while (*p != '\0') {
+    // copy everything up to the next spec as-is
+    const char* percent = strchr(p, '%');
+    if (percent == NULL) {
+      text_printf(&writer, "%s", p);
+      break;
+    }
+    text_printf(&writer, "%.*s", (int) (percent - p), p);
+
+    format_spec spec;
+    p = parse_spec(percent, &spec);
+
+    if (spec.type == ARG_NONE) {
+      if ((spec.length == 2) && (spec.start[1] == '%')) {
+        text_printf(&writer, "%%");
+      } else {
+        text_printf(&writer, "%.*s", (int) spec.length, spec.start);
+      }
+      continue;
+    }
+
+    // take the stars, then the value
+    int stars[2] = {0, 0};
+    size_t size = arg_size(spec.type);
+    size_t needed = (spec.stars * sizeof(int)) + size;
+    if (needed > arg_bytes_left) {
+      // it didn't fit when it was logged, and neither did anything after it
+      arg_bytes_left = 0;
+      text_printf(&writer, "?");
+      continue;
+    }
+    for (uint8_t i=0; i<spec.stars; i++) {
+      memcpy(&stars[i], arg, sizeof(int));
+      arg += sizeof(int);
+    }
+    arg_bytes_left -= needed;
+
+    char spec_format[MAX_SPEC_LENGTH + 1];
+    if ((spec.length > MAX_SPEC_LENGTH) || (spec.type == ARG_IGNORED_POINTER)) {
+      // nothing is ever written through a %n
+      arg += size;
+      if (spec.type != ARG_IGNORED_POINTER) text_printf(&writer, "?");
+      continue;
+    }
+    memcpy(spec_format, spec.start, spec.length);
+    spec_format[spec.length] = '\0';
+
+    switch (spec.type) {
+      case ARG_INT: FORMAT_ARG(int); break;
+      case ARG_LONG: FORMAT_ARG(long); break;
+      case ARG_LONG_LONG: FORMAT_ARG(long long); break;
+      case ARG_INTMAX: FORMAT_ARG(intmax_t); break;
+      case ARG_SIZE: FORMAT_ARG(size_t); break;
+      case ARG_PTRDIFF: FORMAT_ARG(ptrdiff_t); break;
+      case ARG_DOUBLE: FORMAT_ARG(double); break;
+      case ARG_LONG_DOUBLE: FORMAT_ARG(long double); break;
+      case ARG_POINTER: FORMAT_ARG(void*); break;
+      default: break;
+    }
+    arg += size;
+  }
+
+  return writer.used;
+}
+
+void log_ring_flush() {
+  log_entry entry;
+  char line[LOG_RING_LINE_SIZE];
+
+  while (log_ring_pop(&entry)) {
+    log_ring_format(&entry, line, sizeof(line));
+    hal_console_write(line);
+  }
+
+  // let whoever's reading know that they're missing something
+  uint32_t dropped_now = dropped;
+  if (dropped_now != dropped_reported) {
+    snprintf(
+      line,
+      sizeof(line),
+      "[log] %lu messages dropped, the log ring was full",
+      (unsigned long) (dropped_now - dropped_reported)
+    );
+    hal_console_write(line);
+    dropped_reported = dropped_now;
+  }
+}
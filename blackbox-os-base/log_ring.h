@@ -0,0 +1,99 @@
+/*
+ * log_ring.h: Deferred logging
+ *
+ * debug_print formats its message and writes it to the console on the spot,
+ * which is slow (and, on the rp2040, far too slow for an interrupt handler).
+ * A deferred log instead keeps the format string's pointer and the raw bytes
+ * of its arguments in a ring, which only takes a quick scan of the format
+ * string and a few stores. The platform formats and prints the messages later,
+ * when it's idle, with log_ring_flush (or a host can pop them and format them
+ * itself, with log_ring_pop and log_ring_format).
+ *
+ * Since only pointers are kept, the format string, and any string passed for
+ * a %s, have to still be around when the message is printed. String literals
+ * always are.
+ */
+
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdarg.h>
+
+// number of messages that can be waiting to be printed before new ones get
+// dropped. must be a power of 2.
+#ifndef LOG_RING_SIZE
+#define LOG_RING_SIZE 32
+#endif
+
+// most bytes of arguments a message can have (ex: 8 ints, or 4 doubles).
+// arguments past this are left out, and printed as "?".
+#ifndef LOG_RING_MAX_ARG_BYTES
+#define LOG_RING_MAX_ARG_BYTES 32
+#endif
+
+// longest line log_ring_flush prints, longer ones are cut off
+#ifndef LOG_RING_LINE_SIZE
+#define LOG_RING_LINE_SIZE 128
+#endif
+
+#if (LOG_RING_SIZE & (LOG_RING_SIZE - 1)) != 0
+#error "LOG_RING_SIZE must be a power of 2"
+#endif
+
+#if (LOG_RING_MAX_ARG_BYTES < 0) || (LOG_RING_MAX_ARG_BYTES > 255)
+#error "LOG_RING_MAX_ARG_BYTES must be between 0 and 255"
+#endif
+
+/*
+ * One message that hasn't been formatted yet.
+ */
+typedef struct {
+  // the format string, exactly as it was passed in
+  const char* format;
+  // hal_micros() when the message was logged
+  uint32_t timestamp;
+  // how many bytes of `args` are used
+  uint8_t arg_bytes;
+  // the arguments, packed back to back in the order the format uses them
+  uint8_t args[LOG_RING_MAX_ARG_BYTES];
+} log_entry;
+
+/*
+ * Log a message, to be formatted later. Takes a printf format string, see the
+ * top of this file for what has to outlive the call. Safe to call from an
+ * interrupt handler. Returns false if the ring was full, and the message was
+ * dropped.
+ */
+bool log_ring_write(const char* format, ...);
+
+/*
+ * Same as log_ring_write, with a va_list.
+ */
+bool log_ring_writev(const char* format, va_list args);
+
+/*
+ * Take the oldest message out of the ring. Returns false if it's empty.
+ */
+bool log_ring_pop(log_entry* out_entry);
+
+/*
+ * Format a message into `out`, like snprintf: it's null-terminated if there's
+ * room, and the return value is the length of the whole message.
+ */
+size_t log_ring_format(const log_entry* entry, char* out, size_t out_size);
+
+/*
+ * Format and print every message in the ring to the debug console. Call this
+ * when there's nothing better to do (ex: once the executor's batch is done).
+ */
+void log_ring_flush();
+
+/*
+ * Get the number of messages dropped because the ring was full.
+ */
+uint32_t log_ring_dropped();
+
+#endif
@@ -0,0 +1,179 @@
+/*
+ * snapshot.c: Saving and restoring the whole state of a black box
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include "snapshot.h"
+#include "executor_private.h"
+#include "arena.h"
+#include "framebuffer.h"
+#include "hal.h"
+
+/*
+ * ===============
+ * === DEFINES ===
+ * ===============
+ */
+
+// "BBSN", so buffers that aren't snapshots at all get turned away
+#define SNAPSHOT_MAGIC 0x4E534242UL
+
+// bump this whenever the layout of a snapshot changes
+#define SNAPSHOT_VERSION 2
+
+// a snapshot is laid out as:
+// - SNAPSHOT_MAGIC (u32), SNAPSHOT_VERSION (u16)
+// - the length of the executor's part (u32), then the executor's part (see
+//   the SNAPSHOTS section of executor.c)
+// - the matrix (8 bytes), then the tone frequency (u16, 0 = off)
+// - the number of regions (u8), then for each one its size (u32) and contents
+// - the arena's part (see arena.c)
+
+/*
+ * =============
+ * === STATE ===
+ * =============
+ */
+
+typedef struct {
+  void* start;
+  size_t size;
+} snapshot_region;
+
+// memory regions registered by the program, in the order they were registered
+static snapshot_region regions[SNAPSHOT_MAX_REGIONS];
+static uint8_t region_count = 0;
+
+// the tone that's playing, 0 if none
+static uint16_t tone_frequency = 0;
+
+/*
+ * ====================
+ * === PLATFORM API ===
+ * ====================
+ */
+
+size_t snapshot_save(uint8_t* buffer, size_t buffer_size) {
+  snapshot_writer writer = { buffer, buffer_size, 0 };
+
+  uint32_t magic = SNAPSHOT_MAGIC;
+  uint16_t version = SNAPSHOT_VERSION;
+  snapshot_write(&writer, &magic, sizeof(magic));
+  snapshot_write(&writer, &version, sizeof(version));
+
+  // the executor's part is prefixed with its length, so restoring can check
+  // everything after it before the executor gets touched
+  size_t length_at = writer.used;
+  uint32_t length = 0;
+  snapshot_write(&writer, &length, sizeof(length));
+
+  size_t executor_start = writer.used;
+  if (!executor_instance_snapshot(&default_executor, &writer)) return 0;
+  length = writer.used - executor_start;
+
+  if ((length_at + sizeof(length)) <= buffer_size) {
+    memcpy(buffer + length_at, &length, sizeof(length));
+  }
+
+  // the matrix is the default instance's framebuffer
+  uint8_t matrix[8];
+  memcpy(matrix, default_executor.framebuffer_rows, sizeof(matrix));
+  snapshot_write(&writer, matrix, sizeof(matrix));
+  snapshot_write(&writer, &tone_frequency, sizeof(tone_frequency));
+
+  snapshot_write(&writer, &region_count, sizeof(region_count));
+  for (uint8_t i=0; i<region_count; i++) {
+    uint32_t size = regions[i].size;
+    snapshot_write(&writer, &size, sizeof(size));
+    snapshot_write(&writer, regions[i].start, regions[i].size);
+  }
+
+  arena_snapshot(&writer);
+
+  return writer.used;
+}
+
+bool snapshot_restore(const uint8_t* buffer, size_t buffer_size) {
+  snapshot_reader reader = { buffer, buffer_size, 0, true };
+
+  uint32_t magic;
+  uint16_t version;
+  snapshot_read(&reader, &magic, sizeof(magic));
+  snapshot_read(&reader, &version, sizeof(version));
+  if ((magic != SNAPSHOT_MAGIC) || (version != SNAPSHOT_VERSION)) return false;
+
+  uint32_t length;
+  snapshot_read(&reader, &length, sizeof(length));
+  const uint8_t* executor_part = snapshot_skip(&reader, length);
+
+  uint8_t matrix[8];
+  uint16_t tone;
+  uint8_t count;
+  snapshot_read(&reader, matrix, sizeof(matrix));
+  snapshot_read(&reader, &tone, sizeof(tone));
+  snapshot_read(&reader, &count, sizeof(count));
+
+  // the program has to have registered the same regions
+  if (count != region_count) return false;
+
+  const uint8_t* contents[SNAPSHOT_MAX_REGIONS];
+  for (uint8_t i=0; i<count; i++) {
+    uint32_t size;
+    snapshot_read(&reader, &size, sizeof(size));
+    if (size != regions[i].size) return false;
+
+    contents[i] = snapshot_skip(&reader, size);
+  }
+
+  size_t arena_in_use;
+  const uint8_t* arena_contents = arena_restore_check(&reader, &arena_in_use);
+  if (arena_contents == NULL) return false;
+
+  if (!reader.ok) return false;
+
+  // this checks its part before changing anything, so it's the last thing
+  // that can fail
+  snapshot_reader executor_reader = { executor_part, length, 0, true };
+  if (!executor_instance_restore(&default_executor, &executor_reader)) {
+    return false;
+  }
+
+  // send the whole thing, whatever the hal was showing before
+  executor_instance* previous = executor_set_current(&default_executor);
+  framebuffer_set(matrix);
+  framebuffer_invalidate();
+  framebuffer_present();
+  executor_set_current(previous);
+
+  if (tone != 0) {
+    hal_tone(tone);
+  } else {
+    hal_tone_off();
+  }
+  tone_frequency = tone;
+
+  for (uint8_t i=0; i<count; i++) {
+    memcpy(regions[i].start, contents[i], regions[i].size);
+  }
+
+  arena_restore(arena_contents, arena_in_use);
+
+  return true;
+}
+
+bool snapshot_add_region(void* start, size_t size) {
+  if (region_count >= SNAPSHOT_MAX_REGIONS) return false;
+
+  regions[region_count].start = start;
+  regions[region_count].size = size;
+  region_count++;
+
+  return true;
+}
+
+void snapshot_track_tone(uint16_t frequency) {
+  tone_frequency = frequency;
+}
@@ -0,0 +1,129 @@
+/*
+ * snapshot.h: Saving and restoring the whole state of a black box
+ *
+ * A snapshot holds everything needed to put a running program back where it
+ * was: the executor's tasks, queue and timers, the matrix and the tone being
+ * played, the part of the arena that's in use (see arena.h), and any memory
+ * the program registered with bb_snapshot_region.
+ *
+ * Snapshots contain function pointers and raw structs, so they can only be
+ * restored into the same build of the same program, on the same platform. That
+ * covers restarting a game in the editor, which is what they're for.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+
+// most memory regions a program can register
+#ifndef SNAPSHOT_MAX_REGIONS
+#define SNAPSHOT_MAX_REGIONS 8
+#endif
+
+/*
+ * ======================
+ * === BUFFER HELPERS ===
+ * ======================
+ */
+
+// these are shared by everything that puts its state in a snapshot
+
+// appends to a buffer. `used` keeps counting past the end of the buffer, so a
+// writer with no buffer at all can be used to measure a snapshot.
+typedef struct {
+  uint8_t* data;
+  size_t size;
+  size_t used;
+} snapshot_writer;
+
+// reads from a buffer. once a read runs past the end, `ok` is false and every
+// read after it gives zeroes.
+typedef struct {
+  const uint8_t* data;
+  size_t size;
+  size_t used;
+  bool ok;
+} snapshot_reader;
+
+static inline void snapshot_write(
+  snapshot_writer* writer,
+  const void* src,
+  size_t length
+) {
+  if ((writer->used + length) <= writer->size) {
+    memcpy(writer->data + writer->used, src, length);
+  }
+  writer->used += length;
+}
+
+static inline void snapshot_read(
+  snapshot_reader* reader,
+  void* dest,
+  size_t length
+) {
+  if (!reader->ok || ((reader->size - reader->used) < length)) {
+    reader->ok = false;
+    memset(dest, 0, length);
+    return;
+  }
+
+  memcpy(dest, reader->data + reader->used, length);
+  reader->used += length;
+}
+
+// skip over `length` bytes, returning where they start (or NULL if there
+// aren't that many left)
+static inline const uint8_t* snapshot_skip(
+  snapshot_reader* reader,
+  size_t length
+) {
+  if (!reader->ok || ((reader->size - reader->used) < length)) {
+    reader->ok = false;
+    return NULL;
+  }
+
+  const uint8_t* start = reader->data + reader->used;
+  reader->used += length;
+
+  return start;
+}
+
+/*
+ * ====================
+ * === PLATFORM API ===
+ * ====================
+ */
+
+/*
+ * Write a snapshot of the default executor, the device and the registered
+ * memory regions into `buffer`. Returns the size of the snapshot, which is
+ * only written if it fits in `buffer_size` (pass NULL and 0 to measure it).
+ * Returns 0 if a snapshot can't be taken right now (ex: from inside a task).
+ */
+size_t snapshot_save(uint8_t* buffer, size_t buffer_size);
+
+/*
+ * Put everything back the way it was in a snapshot. Timers are shifted so
+ * they're the same distance in the future as when the snapshot was taken.
+ * Returns false, and changes nothing, if the snapshot is invalid or is from a
+ * different build of the program.
+ */
+bool snapshot_restore(const uint8_t* buffer, size_t buffer_size);
+
+/*
+ * Include `size` bytes at `start` in every snapshot. Regions have to be
+ * registered in the same order before restoring. Returns false if there are
+ * already SNAPSHOT_MAX_REGIONS regions.
+ */
+bool snapshot_add_region(void* start, size_t size);
+
+/*
+ * Record the tone being played (0 for none), since the hal can't report it.
+ */
+void snapshot_track_tone(uint16_t frequency);
+
+#endif
@@ -0,0 +1,327 @@
+/*
+ * static_tasks.hpp: Compile-time task tables for C++ programs
+ *
+ * An opt-in, header-only front end to the executor. Instead of creating tasks
+ * one at a time, a C++ program lists them all in a task_table:
+ *
+ *   void move_player() { ... }
+ *   void draw() { ... }
+ *   void on_select() { ... }
+ *
+ *   using game = bb::task_table<
+ *     bb::every_ms<100, move_player>,
+ *     bb::every_ms<50, draw>,
+ *     bb::on_event<EVENT_PRESS_SELECT, on_select>
+ *   >;
+ *
+ *   void user_setup() {
+ *     game::start();
+ *   }
+ *
+ * Everything about the table is worked out by the compiler: which events it
+ * listens for, how often its timers need to be checked, and how much state it
+ * needs (one small counter per timer, nothing per event task). The targets are
+ * template arguments, so they're called directly (and usually inlined) instead
+ * of through a function pointer, and nothing is allocated at runtime.
+ *
+ * A started table is run by the regular C executor, through (at most) two
+ * bridge tasks: a batched event task subscribed to every event in the table,
+ * and a batched interval task that ticks at the greatest common divisor of the
+ * table's timer periods. The platform keeps calling executor_tick_loop /
+ * executor_tick_until_us like it always has, and tasks created with the C api
+ * keep working next to the table.
+ *
+ * To use it, the program has to be built as C++ (see "C++ programs" in
+ * docs/api.md). Everything in here is C++ linkage, so it can be included from
+ * inside an extern "C" block too.
+ */
+
+#ifndef STATIC_TASKS_HPP
+#define STATIC_TASKS_HPP
+
+// the shortest the timer bridge is allowed to tick, in microseconds. periods
+// with a tiny common divisor (ex: 1000 and 1001) would otherwise make it tick
+// every microsecond, so the executor never sleeps. it can fall behind by up to
+// 65535 ticks (the most activations a batched task can count) before runs
+// get dropped, so this also sets how much lag the timers survive.
+#ifndef BB_TASK_TABLE_MIN_TICK_US
+#define BB_TASK_TABLE_MIN_TICK_US 1000
+#endif
+
+extern "C++" {
+
+#include <stdint.h>
+#include <stddef.h>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+extern "C" {
+#include "blackbox.h"
+}
+
+namespace bb {
+
+/*
+ * ================
+ * === INTERNAL ===
+ * ================
+ */
+
+namespace detail {
+
+// greatest common divisor, where 0 means "no period" and is ignored
+constexpr time_duration_us gcd(time_duration_us a, time_duration_us b) {
+  return (b == 0) ? a : gcd(b, a % b);
+}
+
+// greatest common divisor of every period, 0 if there aren't any
+template <typename... periods>
+constexpr time_duration_us gcd_all(periods... period) {
+  time_duration_us result = 0;
+  ((result = gcd(result, period)), ...);
+  return result;
+}
+
+// the smallest unsigned type that can count up to `max`
+template <uint32_t max>
+using counter = typename std::conditional<
+  (max <= 0xFF),
+  uint8_t,
+  typename std::conditional<(max <= 0xFFFF), uint16_t, uint32_t>::type
+>::type;
+
+} // namespace detail
+
+/*
+ * =============
+ * === TASKS ===
+ * =============
+ */
+
+// every kind of task in a table provides:
+// - events: the events it listens for (0 if none)
+// - period: how often it runs in microseconds (0 if it isn't a timer)
+// - state<tick>: whatever it needs to keep between runs, given the table's
+//   tick length
+// - on_events(state, fired): called when any of the table's events fire
+// - on_ticks(state, ticks): called when `ticks` table ticks have passed
+
+/*
+ * Run `target` whenever any of `events` fire.
+ *
+ * Like a batched event task, it runs once per batch of events, however many
+ * fired since it last ran. Use task_fired_events() to see which did (it
+ * includes the events of the rest of the table).
+ */
+template <event_mask events_, void (*target)()>
+struct on_event {
+  static_assert(events_ != 0, "on_event needs at least one event");
+
+  static constexpr event_mask events = events_;
+  static constexpr time_duration_us period = 0;
+
+  // nothing to remember
+  template <time_duration_us tick>
+  struct state {};
+
+  template <time_duration_us tick>
+  static void on_events(state<tick>& self, event_mask fired) {
+    (void) self;
+    if ((fired & events) != 0) target();
+  }
+
+  template <time_duration_us tick>
+  static void on_ticks(state<tick>& self, uint32_t ticks) {
+    (void) self;
+    (void) ticks;
+  }
+};
+
+/*
+ * Run `target` every `period` microseconds. Missed runs are caught up on, like
+ * TASK_CATCH_UP_ALL, as long as the table falls fewer than 65535 of its ticks
+ * behind (see BB_TASK_TABLE_MIN_TICK_US).
+ */
+template <time_duration_us period_, void (*target)()>
+struct every_us {
+  static_assert(period_ != 0, "every_us needs a period above 0");
+
+  static constexpr event_mask events = 0;
+  static constexpr time_duration_us period = period_;
+
+  // the number of table ticks left until the next run, sized to fit
+  template <time_duration_us tick>
+  struct state {
+    detail::counter<period / tick> ticks_left = period / tick;
+  };
+
+  template <time_duration_us tick>
+  static void on_events(state<tick>& self, event_mask fired) {
+    (void) self;
+    (void) fired;
+  }
+
+  template <time_duration_us tick>
+  static void on_ticks(state<tick>& self, uint32_t ticks) {
+    constexpr uint32_t ticks_per_run = period / tick;
+
+    if (ticks < self.ticks_left) {
+      self.ticks_left -= ticks;
+      return;
+    }
+
+    // ran out at least once, see how many whole periods fit in what's left
+    uint32_t overshoot = ticks - self.ticks_left;
+    uint32_t runs = 1 + (overshoot / ticks_per_run);
+    self.ticks_left = ticks_per_run - (overshoot % ticks_per_run);
+
+    while (runs-- > 0) target();
+  }
+};
+
+/*
+ * Run `target` every `period` milliseconds.
+ */
+template <time_duration period_, void (*target)()>
+struct every_ms : every_us<(time_duration_us) ((uint64_t) period_ * 1000), target> {
+  static_assert(
+    period_ <= UINT32_MAX / 1000,
+    "every_ms periods have to fit in time_duration_us, use a shorter one"
+  );
+};
+
+/*
+ * =============
+ * === TABLE ===
+ * =============
+ */
+
+/*
+ * A fixed set of tasks, resolved at compile time. Tasks run in the order
+ * they're listed in whenever they're due at the same time.
+ *
+ * Each distinct task_table type is a separate table, with its own state.
+ */
+template <typename... tasks>
+class task_table {
+  static_assert(sizeof...(tasks) > 0, "a task_table needs at least one task");
+
+public:
+  // every event the table listens for
+  static constexpr event_mask events = (tasks::events | ... | 0);
+
+  // how often the timer bridge runs, in microseconds (0 if there are no
+  // timers). every timer period in the table is a multiple of this, so keep
+  // periods round to keep this big.
+  static constexpr time_duration_us tick = detail::gcd_all(tasks::period...);
+
+  static_assert(
+    tick == 0 || tick >= BB_TASK_TABLE_MIN_TICK_US,
+    "the timer periods in this task_table have a tiny common divisor, so it "
+    "would tick far too often. round the periods off (ex: every_ms<1000> and "
+    "every_ms<250>, not every_us<1000> and every_us<1001>), or lower "
+    "BB_TASK_TABLE_MIN_TICK_US"
+  );
+
+  // the number of tasks in the table
+  static constexpr size_t size = sizeof...(tasks);
+
+  /*
+   * Create the bridge tasks, which starts running the table. Returns false if
+   * the executor ran out of task slots.
+   */
+  static bool start() {
+    stop();
+
+    if constexpr (events != 0) {
+      event_bridge = task_create_event(run_events, events);
+      if (event_bridge == 0) return false;
+      task_set_batched(event_bridge, true);
+    }
+
+    if constexpr (tick != 0) {
+      timer_bridge = task_create_interval_us(run_ticks, tick);
+      if (timer_bridge == 0) {
+        stop();
+        return false;
+      }
+      task_set_batched(timer_bridge, true);
+    }
+
+    return true;
+  }
+
+  /*
+   * Cancel the bridge tasks. The table stops running, and can be started again
+   * (which resets its timers).
+   */
+  static void stop() {
+    if (event_bridge != 0) task_cancel(event_bridge);
+    if (timer_bridge != 0) task_cancel(timer_bridge);
+    event_bridge = 0;
+    timer_bridge = 0;
+    states = state_tuple();
+  }
+
+  /*
+   * Pause every task in the table.
+   */
+  static void pause() {
+    task_pause(event_bridge);
+    task_pause(timer_bridge);
+  }
+
+  /*
+   * Unpause every task in the table.
+   */
+  static void unpause() {
+    task_unpause(event_bridge);
+    task_unpause(timer_bridge);
+  }
+
+  /*
+   * Move the whole table into a task group (see task_set_group).
+   */
+  static void set_group(task_group group) {
+    task_set_group(event_bridge, group);
+    task_set_group(timer_bridge, group);
+  }
+
+private:
+  using state_tuple = std::tuple<typename tasks::template state<tick>...>;
+
+  // the only memory a table takes, besides the two bridge tasks
+  static inline state_tuple states{};
+  static inline task_handle event_bridge = 0;
+  static inline task_handle timer_bridge = 0;
+
+  template <size_t... index>
+  static void dispatch_events(event_mask fired, std::index_sequence<index...>) {
+    (tasks::on_events(std::get<index>(states), fired), ...);
+  }
+
+  template <size_t... index>
+  static void dispatch_ticks(uint32_t ticks, std::index_sequence<index...>) {
+    (tasks::on_ticks(std::get<index>(states), ticks), ...);
+  }
+
+  // target of the event bridge
+  static void run_events(task_handle self) {
+    (void) self;
+    dispatch_events(task_fired_events(), std::index_sequence_for<tasks...>());
+  }
+
+  // target of the timer bridge, it's batched so this gets every tick that
+  // passed since it last ran
+  static void run_ticks(task_handle self) {
+    (void) self;
+    dispatch_ticks(task_activation_count(), std::index_sequence_for<tasks...>());
+  }
+};
+
+} // namespace bb
+
+} // extern "C++"
+
+#endif
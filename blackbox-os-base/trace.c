@@ -0,0 +1,185 @@
+/*
+ * trace.c: Turning executor traces into something a trace viewer can open
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include "trace.h"
+
+/*
+ * ==============
+ * === OUTPUT ===
+ * ==============
+ */
+
+// appends to a string. like snapshot_writer, `used` keeps counting past the
+// end of the buffer, so the whole length is known even if it didn't fit.
+typedef struct {
+  char* data;
+  size_t size;
+  size_t used;
+} json_writer;
+
+static void json_printf(json_writer* writer, const char* format, ...) {
+  // once something didn't fit, stop writing so the output is cut off cleanly
+  size_t left = 0;
+  if (writer->used < writer->size) left = writer->size - writer->used;
+
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(
+    (left > 0) ? (writer->data + writer->used) : NULL,
+    left,
+    format,
+    args
+  );
+  va_end(args);
+
+  if (length > 0) writer->used += (size_t) length;
+}
+
+/*
+ * ====================
+ * === CHROME TRACE ===
+ * ====================
+ */
+
+// the format is described in "Trace Event Format" (google docs), and read by
+// chrome://tracing and https://ui.perfetto.dev. everything goes on one thread
+// track, so matrix and tone calls show up inside the task that made them:
+// - ticks and task runs are nested "B"/"E" (begin/end) slices
+// - activations, events and hal calls are "i" (instant) events
+// - the queue depth is a "C" (counter) track
+
+// start an event, the caller adds its own fields and the closing brace
+static void json_event(
+  json_writer* writer,
+  char phase,
+  const char* name,
+  uint64_t timestamp
+) {
+  json_printf(
+    writer,
+    ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":1,\"tid\":1,\"ts\":%llu",
+    name,
+    phase,
+    (unsigned long long) timestamp
+  );
+}
+
+static void json_queue_counter(
+  json_writer* writer,
+  uint64_t timestamp,
+  uint16_t queued
+) {
+  json_event(writer, 'C', "queue", timestamp);
+  json_printf(writer, ",\"args\":{\"tasks\":%u}}", (unsigned) queued);
+}
+
+size_t trace_format_chrome_json(
+  const trace_record* records,
+  size_t count,
+  char* out,
+  size_t out_size
+) {
+  json_writer writer = { .data = out, .size = out_size, .used = 0 };
+
+  json_printf(
+    &writer,
+    "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+    "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+    "\"args\":{\"name\":\"black box\"}},\n"
+    "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,"
+    "\"args\":{\"name\":\"executor\"}}"
+  );
+
+  // records carry hal_micros(), which wraps every ~71 minutes. unwrap it by
+  // adding up the (wrapping) differences between records.
+  uint64_t timestamp = (count > 0) ? records[0].timestamp : 0;
+  uint32_t last_timestamp = (count > 0) ? records[0].timestamp : 0;
+
+  // the oldest records may have been overwritten, leaving ends of slices
+  // whose beginnings are gone. viewers get confused by those, so skip them.
+  uint32_t open_slices = 0;
+
+  char name[24];
+
+  for (size_t i=0; i<count; i++) {
+    const trace_record* record = &records[i];
+
+    timestamp += (uint32_t) (record->timestamp - last_timestamp);
+    last_timestamp = record->timestamp;
+
+    switch (record->type) {
+      case TRACE_TICK_START:
+        json_event(&writer, 'B', "tick", timestamp);
+        json_printf(&writer, ",\"cat\":\"executor\"}");
+        json_queue_counter(&writer, timestamp, record->value);
+        open_slices++;
+        break;
+
+      case TRACE_RUN_START:
+        snprintf(name, sizeof(name), "task 0x%08lx", (unsigned long) record->task_id);
+        json_event(&writer, 'B', name, timestamp);
+        json_printf(&writer, ",\"cat\":\"task\"}");
+        json_queue_counter(&writer, timestamp, record->value);
+        open_slices++;
+        break;
+
+      case TRACE_TICK_END:
+      case TRACE_RUN_END:
+        if (open_slices == 0) break;
+        json_event(&writer, 'E', "", timestamp);
+        json_printf(&writer, "}");
+        if (record->type == TRACE_TICK_END) {
+          json_queue_counter(&writer, timestamp, record->value);
+        }
+        open_slices--;
+        break;
+
+      case TRACE_TASK_ACTIVATE:
+        json_event(&writer, 'i', "activate", timestamp);
+        json_printf(
+          &writer,
+          ",\"s\":\"t\",\"args\":{\"task\":\"0x%08lx\",\"pending\":%u}}",
+          (unsigned long) record->task_id,
+          (unsigned) record->value
+        );
+        break;
+
+      case TRACE_EVENT:
+        snprintf(name, sizeof(name), "event %u", (unsigned) record->value);
+        json_event(&writer, 'i', name, timestamp);
+        json_printf(&writer, ",\"s\":\"t\"}");
+        break;
+
+      case TRACE_HAL_MATRIX:
+        json_event(&writer, 'i', "matrix", timestamp);
+        json_printf(
+          &writer,
+          ",\"s\":\"t\",\"args\":{\"lit\":%u}}",
+          (unsigned) record->value
+        );
+        break;
+
+      case TRACE_HAL_TONE:
+        json_event(&writer, 'i', "tone", timestamp);
+        json_printf(
+          &writer,
+          ",\"s\":\"t\",\"args\":{\"frequency\":%u}}",
+          (unsigned) record->value
+        );
+        break;
+
+      default:
+        // from a newer executor, or garbage
+        break;
+    }
+  }
+
+  json_printf(&writer, "\n]}\n");
+
+  return writer.used;
+}
@@ -0,0 +1,129 @@
+/*
+ * trace.h: Execution trace of the executor
+ *
+ * When the executor is built with EXECUTOR_ENABLE_TRACE, it writes a compact
+ * binary record into a fixed-size ring for everything it does: ticks, task
+ * activations and runs, events, and calls out to the hal. The platform drains
+ * the ring whenever it likes (see executor_trace_drain), and can turn the
+ * records into a Chrome trace (https://ui.perfetto.dev or chrome://tracing
+ * open these) with trace_format_chrome_json.
+ *
+ * Writing a record is a hal_micros() call and a 12 byte copy, so tracing
+ * barely moves the timings it measures, unlike printing to a console.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "executor_config.h"
+
+// EXECUTOR_TRACE_SIZE is a power of 2, so this turns a position into an index
+#define TRACE_RING_MASK (EXECUTOR_TRACE_SIZE - 1)
+
+typedef enum {
+  // a tick started. value = tasks on the queue
+  TRACE_TICK_START = 0,
+  // a tick finished. value = tasks on the queue
+  TRACE_TICK_END = 1,
+  // a task was activated. task_id = the task, value = its pending activations
+  TRACE_TASK_ACTIVATE = 2,
+  // a task started running. task_id = the task, value = tasks on the queue
+  TRACE_RUN_START = 3,
+  // a task finished running. task_id = the task
+  TRACE_RUN_END = 4,
+  // an event was dispatched. value = the event id
+  TRACE_EVENT = 5,
+  // the matrix was written to. value = the number of lit leds
+  TRACE_HAL_MATRIX = 6,
+  // a tone started or stopped. value = its frequency, 0 when stopped
+  TRACE_HAL_TONE = 7,
+} trace_type;
+
+/*
+ * One thing the executor did.
+ */
+typedef struct {
+  // hal_micros() when it happened
+  uint32_t timestamp;
+  // the task it happened to, or 0
+  uint32_t task_id;
+  // depends on the type
+  uint16_t value;
+  // a trace_type
+  // NOTE: uint8_t to save size on struct alignment
+  uint8_t type;
+} trace_record;
+
+// the ring only ever has one user (the thread ticking the executor, which
+// also drains it in between ticks), so unlike the event ring it needs no
+// atomics. once it's full, new records overwrite the oldest ones.
+typedef struct {
+  trace_record records[EXECUTOR_TRACE_SIZE];
+  // position of the oldest record
+  uint16_t head;
+  // number of records in the ring
+  uint16_t count;
+  // number of records overwritten before they were drained
+  uint32_t dropped;
+} trace_ring;
+
+/*
+ * Empty the ring.
+ */
+static inline void trace_ring_init(trace_ring* ring) {
+  ring->head = 0;
+  ring->count = 0;
+  ring->dropped = 0;
+}
+
+/*
+ * Add a record to the ring, overwriting the oldest one if it's full.
+ */
+static inline void trace_ring_push(trace_ring* ring, const trace_record* record) {
+  if (ring->count == EXECUTOR_TRACE_SIZE) {
+    ring->head = (ring->head + 1) & TRACE_RING_MASK;
+    ring->count--;
+    ring->dropped++;
+  }
+
+  ring->records[(ring->head + ring->count) & TRACE_RING_MASK] = *record;
+  ring->count++;
+}
+
+/*
+ * Move up to `max_records` of the oldest records into `out_records`. Returns
+ * how many were moved.
+ */
+static inline size_t trace_ring_drain(
+  trace_ring* ring,
+  trace_record* out_records,
+  size_t max_records
+) {
+  size_t drained = 0;
+
+  while ((ring->count > 0) && (drained < max_records)) {
+    out_records[drained] = ring->records[ring->head];
+    ring->head = (ring->head + 1) & TRACE_RING_MASK;
+    ring->count--;
+    drained++;
+  }
+
+  return drained;
+}
+
+/*
+ * Write `count` records as a Chrome trace (JSON) into `out`, which is
+ * null-terminated if there's room. Returns the length of the whole trace, not
+ * counting the terminator, even if it didn't fit (pass NULL and 0 to measure
+ * it). The records have to be in the order they were drained in.
+ */
+size_t trace_format_chrome_json(
+  const trace_record* records,
+  size_t count,
+  char* out,
+  size_t out_size
+);
+
+#endif
@@ -1,39 +1,12 @@
-// globals: millis, tone, noTone, displayState, updateDisplay, buttonState,
-// panic, pullEventActivations
+// globals: millis, micros, tone, noTone, buttonState, panic
+// the matrix isn't here, it lives in wasm memory (see plat_hal.c)
 
 mergeInto(LibraryManager.library, {
   hal_millis: function() {
     return globalThis.millis();
   },
-  hal_matrix_set_arr: function(ptr) {
-    let arr = new Uint8Array(Module.HEAP8.buffer, ptr, 8);
-    //console.log(`Setting matrix to:`);
-    //for (let i = 0; i < 8; i++) {
-    //    console.log(arr[i].toString(2));
-    //}
-    // convert the array of ints to an array of arrays of booleans
-    for (let i = 0; i < 8; i++) {
-      let row = arr[i];
-      let paddedByte = row.toString(2).padStart(8, '0');
-      //console.log(`Padded byte for ${row}: ${paddedByte}`);
-      let result = paddedByte.split('').map(function(bit) {
-        return bit === '1';
-      });
-      //console.log(`Resulting row: ${result}`);
-      globalThis.displayState[i] = result;
-    }
-    //console.log(`Setting display to:`);
-    //console.log(displayState);
-    globalThis.updateDisplay();
-  },
-  hal_matrix_get_arr: function(ptr) {
-    let arr = new Uint8Array(Module.HEAP8.buffer, ptr, 8);
-    // convert an array of arrays of booleans to an array of ints
-    for (let i = 0; i < 8; i++) {
-      arr[i] = parseInt(globalThis.displayState[i].map(function(bit) {
-        return bit ? '1' : '0';
-      }).join(''), 2);
-    }
+  hal_micros: function() {
+    return globalThis.micros();
   },
   hal_button_get_state: function(button){
     switch (button) {
@@ -71,14 +44,5 @@ mergeInto(LibraryManager.library, {
   },
   hal_rand: function() {
     return Math.trunc(Math.random() * 65536);
-  },
-  plat_get_events: function(ptr) {
-    let arr = new Uint8Array(Module.HEAP8.buffer, ptr, 32);
-
-    const activs = pullEventActivations();
-
-    for (let i=0; i<activs.length; i++) {
-      arr[i] = activs[i];
-    }
   }
 });
@@ -1,16 +1,17 @@
 /*
  * plat_hal.c: WASM implementation of the hardware abstraction layer.asm
- * This is just telling C that these funcs exist - in reality, they're all
- * implemented in js/plat_hal.js.
+ * This is mostly just telling C that these funcs exist - in reality, they're
+ * implemented in js/plat_hal.js. The matrix is the exception, see below.
 */
 
 #include "hal.h"
 
-extern uint32_t hal_millis();
+#include <string.h>
+#include <emscripten.h>
 
-extern void hal_matrix_set_arr(uint8_t arr[8]);
+extern uint32_t hal_millis();
 
-extern void hal_matrix_get_arr(uint8_t out_arr[8]);
+extern uint32_t hal_micros();
 
 extern hal_button_state hal_button_get_state(hal_button button);
 
@@ -22,6 +23,40 @@ extern void hal_console_write(char* str);
 
 extern void hal_panic(const char* str);
 
+// the matrix lives in linear memory, where the worker reads it straight out of
+// a typed array view whenever it renders, instead of being copied out to js
+// on every change
+typedef struct {
+  // bumped on every change, so js can tell when there's nothing new to draw
+  uint32_t generation;
+  // top to bottom, with the most significant bit on the left
+  uint8_t rows[8];
+} plat_display_state;
+
+static plat_display_state plat_display = {0};
+
+// js calls this once to find the display, then builds its views on top of it
+EMSCRIPTEN_KEEPALIVE
+plat_display_state* plat_display_address() {
+  return &plat_display;
+}
+
+void hal_matrix_set_arr(uint8_t arr[8]) {
+  memcpy(plat_display.rows, arr, sizeof(plat_display.rows));
+  plat_display.generation++;
+}
+
+void hal_matrix_set_rows(uint8_t arr[8], uint8_t rows) {
+  for (int i=0; i<8; i++) {
+    if (rows & (1 << i)) plat_display.rows[i] = arr[i];
+  }
+  plat_display.generation++;
+}
+
+void hal_matrix_get_arr(uint8_t out_arr[8]) {
+  memcpy(out_arr, plat_display.rows, sizeof(plat_display.rows));
+}
+
 // these are no-ops on wasm
 
 void hal_critical_enter() {};
@@ -1,6 +1,10 @@
 #include "hal.h"
 #include "executor_private.h"
 #include "user.h"
+#include "snapshot.h"
+#include "trace.h"
+#include "log_ring.h"
+#include "framebuffer.h"
 
 #include <stdint.h>
 #include <stdio.h>
@@ -10,16 +14,84 @@ EMSCRIPTEN_KEEPALIVE
 void plat_init() {
   executor_init();
   user_setup(); // call into user setup
+  // setup isn't a task, so nothing has shown what it drew yet
+  framebuffer_present();
 }
 
-extern void plat_get_events(uint8_t* events);
+// called by js whenever a button event happens
+EMSCRIPTEN_KEEPALIVE
+void plat_push_event(int event_id) {
+  executor_push_event((uint8_t) event_id);
+}
+
+// times are passed as doubles (in microseconds), since js numbers can hold
+// them exactly for a few hundred years, and 64-bit ints would need BigInt
+// returns -1 if no timers need the event loop to be reticked
+EMSCRIPTEN_KEEPALIVE
+double plat_tick(double current_time) {
+  uint64_t current_time_us = (uint64_t) current_time;
+
+  // drain as much of the queue as the budget allows, so we don't bounce back
+  // through js (and a setTimeout) for every single task
+  uint64_t next_ts = executor_tick_until_us(
+    current_time_us,
+    EXECUTOR_BATCH_MAX_TASKS,
+    current_time_us + (uint64_t) EXECUTOR_BATCH_BUDGET_MS * 1000
+  );
+
+  // the batch is done, print what it logged with debug_print_deferred
+  log_ring_flush();
+
+  if (next_ts == EXECUTOR_WAKE_NEVER) return -1;
+
+  return (double) next_ts;
+}
 
+// snapshots go through buffers that js allocates with malloc
+// call with a size of 0 to find out how big the buffer needs to be
+// returns 0 if a snapshot can't be taken
 EMSCRIPTEN_KEEPALIVE
-unsigned int plat_tick(unsigned int current_time) {
-  uint8_t events[32];
-  plat_get_events(events);
+int plat_snapshot_save(uint8_t* buffer, int size) {
+  return (int) snapshot_save(buffer, (size_t) size);
+}
+
+EMSCRIPTEN_KEEPALIVE
+bool plat_snapshot_restore(const uint8_t* buffer, int size) {
+  return snapshot_restore(buffer, (size_t) size);
+}
+
+#if EXECUTOR_ENABLE_TRACE
+// records drained from the executor that haven't been exported yet
+static trace_record trace_records[EXECUTOR_TRACE_SIZE];
+static size_t trace_record_count = 0;
+#endif
+
+// drain the executor's trace, and write it as a chrome trace (JSON) into a
+// buffer that js allocates with malloc, like the snapshots. call with a size
+// of 0 to find out how long it is (the buffer needs 1 more byte for the
+// terminator). the records are only let go of once they've been written.
+// returns 0 if tracing isn't enabled in this build
+EMSCRIPTEN_KEEPALIVE
+int plat_trace_export(char* buffer, int size) {
+#if EXECUTOR_ENABLE_TRACE
+  trace_record_count += executor_trace_drain(
+    &trace_records[trace_record_count],
+    EXECUTOR_TRACE_SIZE - trace_record_count
+  );
+
+  size_t length = trace_format_chrome_json(
+    trace_records,
+    trace_record_count,
+    buffer,
+    (size_t) size
+  );
+  if (length < (size_t) size) trace_record_count = 0;
 
-  uint32_t next_ts = executor_tick_loop(current_time, events);
+  return (int) length;
+#else
+  (void) buffer;
+  (void) size;
 
-  return next_ts;
+  return 0;
+#endif
 }
@@ -1,13 +1,29 @@
+# set EXECUTOR_CHECK_LEVEL to pick how much the executor checks itself at
+# runtime (2 = full, 1 = cheap, 0 = none, see executor_config.h)
+# ex: EXECUTOR_CHECK_LEVEL=0 ./build.sh
+# set EXECUTOR_ENABLE_TRACE=1 to record a trace the editor can download (see
+# trace.h)
+# set USER_SOURCE to build a different program, ex: a C++ one that uses
+# static_tasks.hpp (it has to declare user_setup as extern "C")
+# ex: USER_SOURCE=./intermediate_files/user.cpp ./build.sh
 emcc \
   ./blackbox-os-base/api_impl.c \
   ./blackbox-os-base/executor.c \
+  ./blackbox-os-base/snapshot.c \
+  ./blackbox-os-base/trace.c \
+  ./blackbox-os-base/log_ring.c \
+  ./blackbox-os-base/arena.c \
+  ./blackbox-os-base/framebuffer.c \
   ./blackbox-os-wasm/plat_hal.c \
   ./blackbox-os-wasm/plat_main.c \
-  ./intermediate_files/user.c \
+  ${USER_SOURCE:-./intermediate_files/user.c} \
   -o ./intermediate_files/user.js \
   -I ./blackbox-os-base/ \
+  ${EXECUTOR_CHECK_LEVEL:+-DEXECUTOR_CHECK_LEVEL=$EXECUTOR_CHECK_LEVEL} \
+  ${EXECUTOR_ENABLE_TRACE:+-DEXECUTOR_ENABLE_TRACE=$EXECUTOR_ENABLE_TRACE} \
   --js-library ./blackbox-os-wasm/jslib.js \
   -s WASM=1 \
   -s MODULARIZE=1 \
   -s EXPORT_ES6=1 \
-  -s EXPORTED_FUNCTIONS="['_plat_init','_plat_tick']"
+  -s EXPORTED_RUNTIME_METHODS=HEAP8 \
+  -s EXPORTED_FUNCTIONS="['_plat_init','_plat_tick','_plat_push_event','_plat_snapshot_save','_plat_snapshot_restore','_plat_trace_export','_plat_display_address','_malloc','_free']"
@@ -25,12 +25,15 @@ let unlocked;
 let matrix_color;
 let oscillator;
 let animation_frame;
-// spare copy of the matrix's enabled pixels
+// spare copy of the matrix's rows
 // this allows us to do instant color changes
-let _on_pixels = [];
+let _rows = new Uint8Array(8);
 
 let code_before_example;
 
+// the last snapshot taken with #save_checkpoint, and the code it was taken from
+let checkpoint;
+
 let messages;
 let active_message;
 
@@ -75,6 +78,9 @@ const e_info = document.getElementById('info');
 const e_debug = document.getElementById('debug');
 const e_toggle_running = document.getElementById('toggle_running');
 const e_build_uf2 = document.getElementById('build_uf2');
+const e_save_checkpoint = document.getElementById('save_checkpoint');
+const e_load_checkpoint = document.getElementById('load_checkpoint');
+const e_download_trace = document.getElementById('download_trace');
 const e_toggle_view = document.getElementById('toggle_view');
 const e_change_color = document.getElementById('change_color');
 const e_permalink = document.getElementById('permalink');
@@ -267,7 +273,7 @@ function new_worker () {
   worker.onmessage = function (e) {
     console.log(`[main] worker thread says: ${e.data.message}`);
     if (e.data.message === 'draw_to_canvas') {
-      draw_to_canvas(e.data.on_pixels);
+      draw_to_canvas(e.data.rows);
     }
     if (e.data.message === 'tone') {
       oscillator.frequency.value = e.data.frequency;
@@ -311,16 +317,16 @@ function blank_matrix () {
 }
 
 /**
- * Draw the matrix to the canvas with the pixels at the provided indices turned on.
- * @param {number[]} on_pixels
+ * Draw the matrix to the canvas, one byte per row, with the most significant
+ * bit on the left.
+ * @param {Uint8Array} rows
  */
-function draw_to_canvas (on_pixels) {
+function draw_to_canvas (rows) {
   victus.clear();
   const c = ['#ef654d', '#fbb601', '#c7e916'][matrix_color];
   for (let y = 0; y < 8; y++) {
     for (let x = 0; x < 8; x++) {
-      const i = (y * 8) + x;
-      if (on_pixels.includes(i)) {
+      if (rows[y] & (0x80 >> x)) {
         victus.ctx.fillStyle = c;
       } else {
         victus.ctx.fillStyle = '#444';
@@ -330,8 +336,8 @@ function draw_to_canvas (on_pixels) {
       victus.ctx.fill();
     }
   }
-  // set this file's version of on_pixels
-  _on_pixels = on_pixels;
+  // set this file's version of rows
+  _rows = rows;
 }
 
 /**
@@ -512,7 +518,7 @@ e_change_color.onclick = function () {
   localStorage.setItem('matrix_color', JSON.stringify(matrix_color));
   e_info_container.classList.remove('dn');
   e_info.innerHTML = `Changed color to ${['red', 'yellow', 'green'][matrix_color]}`;
-  draw_to_canvas(_on_pixels);
+  draw_to_canvas(_rows);
 }
 
 /**
@@ -554,6 +560,9 @@ e_toggle_running.onclick = async function () {
     worker.terminate();
     // update UI
     e_info_container.classList.add('dn');
+    e_save_checkpoint.classList.add('dn');
+    e_load_checkpoint.classList.add('dn');
+    e_download_trace.classList.add('dn');
     e_toggle_running.innerHTML = 'Start';
     e_status.className = 'warning';
     e_status.innerHTML = 'Status: Stopped';
@@ -585,6 +594,9 @@ e_toggle_running.onclick = async function () {
       // 6. update UI, start checking buttons
       e_debug.innerHTML = '';
       e_info_container.classList.remove('dn');
+      e_save_checkpoint.classList.remove('dn');
+      e_load_checkpoint.classList.remove('dn');
+      e_download_trace.classList.remove('dn');
       e_info.innerHTML = 'Use arrow keys + X';
       e_toggle_running.innerHTML = 'Stop';
       e_status.className = 'success';
@@ -602,6 +614,76 @@ e_toggle_running.onclick = async function () {
   }
 }
 
+/**
+ * Callback for `#save_checkpoint`.
+ * Take a snapshot of the running program.
+ */
+e_save_checkpoint.onclick = async function () {
+  try {
+    checkpoint = {
+      code: editor_view.state.doc.toString(),
+      snapshot: await send_message('snapshot'),
+    };
+    e_status.className = 'success';
+    e_status.innerHTML = 'Status: Checkpoint saved';
+  } catch (e) {
+    e_status.className = 'error';
+    e_status.innerText = `Error: ${format(e.message)}`;
+  }
+}
+
+/**
+ * Callback for `#load_checkpoint`.
+ * Put the running program back to the last checkpoint. This also works after
+ * restarting, as long as the code hasn't changed.
+ */
+e_load_checkpoint.onclick = async function () {
+  if (checkpoint === undefined) {
+    e_status.className = 'warning';
+    e_status.innerHTML = 'Status: No checkpoint saved';
+    return;
+  }
+  // a snapshot is full of pointers into the program it was taken from
+  if (checkpoint.code !== editor_view.state.doc.toString()) {
+    e_status.className = 'warning';
+    e_status.innerHTML = 'Status: The code changed since the checkpoint';
+    return;
+  }
+  try {
+    await send_message('restore', { snapshot: checkpoint.snapshot });
+    e_status.className = 'success';
+    e_status.innerHTML = 'Status: Checkpoint restored';
+  } catch (e) {
+    e_status.className = 'error';
+    e_status.innerText = `Error: ${format(e.message)}`;
+  }
+}
+
+/**
+ * Callback for `#download_trace`.
+ * Download what the executor did since the last download, as a chrome trace
+ * (open it in https://ui.perfetto.dev). Only works if the server has tracing
+ * enabled.
+ */
+e_download_trace.onclick = async function () {
+  try {
+    const trace = await send_message('trace');
+    const url = URL.createObjectURL(new Blob([trace], { type: 'application/json' }));
+    const a = document.createElement('a');
+    a.href = url;
+    a.download = "blackbox-trace.json";
+    document.body.appendChild(a);
+    a.click();
+    document.body.removeChild(a);
+    URL.revokeObjectURL(url);
+    e_status.className = 'success';
+    e_status.innerHTML = 'Status: Trace downloaded';
+  } catch (e) {
+    e_status.className = 'error';
+    e_status.innerText = `Error: ${format(e.message)}`;
+  }
+}
+
 e_build_uf2.onclick = async function () {
   const code = editor_view.state.doc.toString();
   console.log('[main] building uf2...');
@@ -9,19 +9,15 @@ let compiler_endpoint = "";
 
 let module;
 let startTime;
-let displayState = [];
-
-for (let i=0; i<8; i++) {
-  displayState[i] = new Array(8).fill(false);
-}
-
-globalThis.displayState = displayState;
+// views of the matrix in wasm memory (see plat_hal.c), made once the module
+// is loaded
+let displayGeneration;
+let displayRows;
+let drawnGeneration;
 
 let run = false;
 let ticking = false;
 
-let eventActivations = new Array(32).fill(0);
-
 let buttonState = {
   up: false,
   down: false,
@@ -52,19 +48,23 @@ function millis() {
 
 globalThis.millis = millis;
 
-function pullEventActivations() {
-  let arr = eventActivations;
-  eventActivations = new Array(32).fill(0);
-
-  return arr;
+function micros() {
+  // wrap like a uint32, the same as the hardware does
+  return Math.floor((performance.now() - startTime) * 1000) >>> 0;
 }
 
-globalThis.pullEventActivations = pullEventActivations;
+globalThis.micros = micros;
+
+// like micros, but doesn't wrap. this is what the executor runs on.
+function microsPrecise() {
+  return Math.floor((performance.now() - startTime) * 1000);
+}
 
 function pushSingleEvent(event_id) {
   console.log("[worker] pushSingleEvent:", event_id);
 
-  eventActivations[event_id]++;
+  // straight into the executor's event ring, timestamped on the way in
+  module._plat_push_event(event_id);
 
   tickSoon();
 }
@@ -77,21 +77,20 @@ function tickSoon() {
 function tickLoop() {
   if (!run) return;
 
-  let nextTimestamp = module._plat_tick(millis());
+  // times are in microseconds
+  let nextTimestamp = module._plat_tick(microsPrecise());
+  updateDisplay();
 
   //console.log("[worker]", nextTimestamp);
 
   // no timers need the event loop to be reticked
-
-  // our 0xFFFFFFFF from js turns into a -1 here, but man i am too tired to
-  // figure this out right now...
-  if (nextTimestamp == -1) {
+  if (nextTimestamp < 0) {
     ticking = false;
     return;
   }
 
-  let now = millis();
-  let delta = nextTimestamp - now;
+  let now = microsPrecise();
+  let delta = (nextTimestamp - now) / 1000;
 
   if (delta <= 0) delta = 0;
 
@@ -99,26 +98,27 @@ function tickLoop() {
 }
 
 /**
- * Create an array containing the indices of every pixel in the matrix that's
- * turned on, and send a message `draw_to_canvas` to the main thread telling
- * it to update the canvas.
+ * Point the display views at the matrix in the module's memory.
+ */
+function bindDisplay() {
+  const ptr = module._plat_display_address();
+  displayGeneration = new Uint32Array(module.HEAP8.buffer, ptr, 1);
+  displayRows = new Uint8Array(module.HEAP8.buffer, ptr + 4, 8);
+  drawnGeneration = undefined;
+}
+
+/**
+ * If the matrix changed since it was last drawn, send a message
+ * `draw_to_canvas` to the main thread with a copy of its rows, telling it to
+ * update the canvas.
  */
 function updateDisplay() {
-  const on_pixels = [];
-  for (let y = 0; y < 8; y++) {
-    for (let x = 0; x < 8; x++) {
-      const i = (y * 8) + x;
-      if (displayState[y][x]) {
-        on_pixels.push(i);
-      }
-    }
-  }
+  if (displayGeneration[0] === drawnGeneration) return;
+  drawnGeneration = displayGeneration[0];
 
-  self.postMessage({ message: 'draw_to_canvas', on_pixels });
+  self.postMessage({ message: 'draw_to_canvas', rows: displayRows.slice() });
 }
 
-globalThis.updateDisplay = updateDisplay;
-
 function tone(freq) {
   self.postMessage({ message: 'tone', frequency: freq });
 }
@@ -218,7 +218,9 @@ async function main() {
   ticking = true;
 
   console.log("[worker] plat init...");
+  bindDisplay();
   module._plat_init();
+  updateDisplay();
   console.log("[worker] ok!");
 
 
@@ -268,12 +270,84 @@ async function stop() {
   run = false;
 }
 
+/**
+ * Callback for `snapshot` message.
+ * Save the state of the running program.
+ * @returns {Uint8Array} the snapshot
+ */
+async function snapshot() {
+  if (!run) throw new Error("the emulator is not running");
+
+  // ask how big it is first, then have it written into wasm memory
+  const size = module._plat_snapshot_save(0, 0);
+  if (size === 0) throw new Error("a snapshot can't be taken right now");
+
+  const ptr = module._malloc(size);
+  try {
+    module._plat_snapshot_save(ptr, size);
+    return new Uint8Array(module.HEAP8.buffer, ptr, size).slice();
+  } finally {
+    module._free(ptr);
+  }
+}
+
+/**
+ * Callback for `restore` message.
+ * Put the running program back into the state of a snapshot.
+ * @param {object} data
+ * @param {Uint8Array} data.snapshot
+ */
+async function restore(data) {
+  if (!run) throw new Error("the emulator is not running");
+
+  const size = data.snapshot.length;
+  const ptr = module._malloc(size);
+  let ok;
+  try {
+    new Uint8Array(module.HEAP8.buffer, ptr, size).set(data.snapshot);
+    ok = module._plat_snapshot_restore(ptr, size);
+  } finally {
+    module._free(ptr);
+  }
+
+  if (!ok) throw new Error("the snapshot doesn't match this program");
+
+  updateDisplay();
+
+  // the timers changed, so the next wakeup probably did too
+  tickSoon();
+}
+
+/**
+ * Callback for `trace` message.
+ * Drain the executor's trace.
+ * @returns {string} everything traced since the last call, as a chrome trace
+ */
+async function trace() {
+  if (!run) throw new Error("the emulator is not running");
+
+  // same dance as snapshots, plus a byte for the terminator
+  const length = module._plat_trace_export(0, 0);
+  if (length === 0) throw new Error("tracing isn't enabled on this server");
+
+  const ptr = module._malloc(length + 1);
+  try {
+    module._plat_trace_export(ptr, length + 1);
+    return new TextDecoder().decode(new Uint8Array(module.HEAP8.buffer, ptr, length));
+  } finally {
+    module._free(ptr);
+  }
+}
+
 const messages = create_messages(
   initialize_emu,
   compile_code,
   main,
   button,
   stop,
+  snapshot,
+  restore,
+  trace,
 );
 
 self.addEventListener('message', event => {
@@ -36,8 +36,33 @@ app.get('/docs/api.md', (req, res) => {
     res.sendFile(__dirname + '/docs/api.md');
     })
 
+// how much the executor checks itself at runtime, per build (see EXECUTOR_CHECK_LEVEL in executor_config.h)
+// 2 = full, 1 = cheap, 0 = none. unset uses the platform's default (full for wasm, cheap for the uf2)
+// ex: EXECUTOR_CHECK_LEVEL_UF2=0 npm start
+function checkLevelFlag(envName){
+    const level = process.env[envName];
+    if (level === undefined || level === "") return "";
+    if (!/^[0-2]$/.test(level)){
+        throw new Error(`${envName} must be 0, 1 or 2, got "${level}"`);
+    }
+    return `-DEXECUTOR_CHECK_LEVEL=${level} `;
+}
+// set EXECUTOR_TRACE_WASM=1 to let the editor download a trace of the executor (see trace.h)
+// ex: EXECUTOR_TRACE_WASM=1 npm start
+function traceFlag(envName){
+    const enabled = process.env[envName];
+    if (enabled === undefined || enabled === "" || enabled === "0") return "";
+    if (enabled !== "1"){
+        throw new Error(`${envName} must be 0 or 1, got "${enabled}"`);
+    }
+    return "-DEXECUTOR_ENABLE_TRACE=1 ";
+}
+const wasmFlags = checkLevelFlag("EXECUTOR_CHECK_LEVEL_WASM") + traceFlag("EXECUTOR_TRACE_WASM");
+const uf2Flags = checkLevelFlag("EXECUTOR_CHECK_LEVEL_UF2");
+
 function generateCodeId(code){
-    return crypto.createHash('sha256').update(code).digest('base64url');
+    // builds with different flags can't share cached output
+    return crypto.createHash('sha256').update(code).update(wasmFlags + uf2Flags).digest('base64url');
 }
 
 const limiter = rateLimit({
@@ -51,8 +76,13 @@ const limiter = rateLimit({
 app.post('/compile', limiter, async (req, res) => {
     const data = req.body;
     const rawCode = data.code;
+    // C++ programs (ex: ones using static_tasks.hpp) are sent with language "cpp"
+    const cpp = data.language === "cpp";
+    const extension = cpp ? ".cpp" : ".c";
+    // the platforms call user_setup from C, so a C++ program's has to have C linkage
+    const linkage = cpp ? "extern \"C\" void user_setup();\n" : "";
     // redefine millis and setup to avoid conflict w/ arduino api
-    const code = "#define millis bb_millis\n#define setup user_setup\n" + rawCode + "\n#undef millis\n#undef setup\n";
+    const code = linkage + "#define millis bb_millis\n#define setup user_setup\n" + rawCode + "\n#undef millis\n#undef setup\n";
 
     const codeId = generateCodeId(code);
     console.log(`Received code with id ${codeId}`);
@@ -70,7 +100,7 @@ app.post('/compile', limiter, async (req, res) => {
         } catch (err){
             // file doesn't exist, so we need to compile
             await fs.mkdir(__dirname + "/intermediate_files/" + codeId, { recursive: true });
-            await fs.writeFile(__dirname + "/intermediate_files/" + codeId + "/" + codeId + ".c", code);
+            await fs.writeFile(__dirname + "/intermediate_files/" + codeId + "/" + codeId + extension, code);
             await fs.writeFile(__dirname + "/intermediate_files/" + codeId + "/" + codeId + ".h", "// this file only exists so the IDE picks up on it as a lib"); 
             try{
                 await exec(
@@ -79,7 +109,7 @@ app.post('/compile', limiter, async (req, res) => {
                     `--output-dir ./intermediate_files/${codeId} ` +
                     "--library ./blackbox-os-base/ " +
                     `--library ./intermediate_files/${codeId} ` +
-                    `--build-property 'compiler.flags=-march=armv6-m -mcpu=cortex-m0plus -mthumb -ffunction-sections -fdata-sections -fno-exceptions -DUSER_CODE_LIB="${codeId}.h"' ` +
+                    `--build-property 'compiler.flags=-march=armv6-m -mcpu=cortex-m0plus -mthumb -ffunction-sections -fdata-sections -fno-exceptions ${uf2Flags}-DUSER_CODE_LIB="${codeId}.h"' ` +
                     `./blackbox-os-arduino/blackbox-os-arduino.ino`
                 )
                 // to explain that build-property mess, that's the least bad way I found to define things on the command line
@@ -101,24 +131,30 @@ app.post('/compile', limiter, async (req, res) => {
             return
         } catch (err){
             // file doesn't exist, so we need to compile
-            await fs.writeFile(__dirname + "/intermediate_files/" + codeId + ".c", code);
+            await fs.writeFile(__dirname + "/intermediate_files/" + codeId + extension, code);
             try{
                 // stupid
                 await exec(
                     "emcc " +
                     "./blackbox-os-base/api_impl.c " +
                     "./blackbox-os-base/executor.c " +
+                    "./blackbox-os-base/snapshot.c " +
+                    "./blackbox-os-base/trace.c " +
+                    "./blackbox-os-base/log_ring.c " +
+                    "./blackbox-os-base/arena.c " +
+                    "./blackbox-os-base/framebuffer.c " +
                     "./blackbox-os-wasm/plat_hal.c " +
                     "./blackbox-os-wasm/plat_main.c " +
-                    `./intermediate_files/${codeId}.c ` +
+                    `./intermediate_files/${codeId}${extension} ` +
                     `-o ./intermediate_files/${codeId}.js ` +
                     "-I ./blackbox-os-base/ " +
+                    wasmFlags +
                     "--js-library ./blackbox-os-wasm/jslib.js " +
                     "-s WASM=1 " +
                     "-s MODULARIZE=1 " +
                     "-s EXPORT_ES6=1 " +
                     "-sEXPORTED_RUNTIME_METHODS=HEAP8 " + // now needed for emscripten 4.0.7 (:
-                    `-s EXPORTED_FUNCTIONS="['_plat_init','_plat_tick']" ` +
+                    `-s EXPORTED_FUNCTIONS="['_plat_init','_plat_tick','_plat_push_event','_plat_snapshot_save','_plat_snapshot_restore','_plat_trace_export','_plat_display_address','_malloc','_free']" ` +
                     "-Werror=incompatible-function-pointer-types-strict"
                 )
             } catch (err){